@@ -0,0 +1,30 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <cstdint>
+
+namespace MGVisualizer
+{
+    /// <summary>
+    /// Counts heap allocations made through the global operator new of the program,
+    /// which AllocationCounter.cpp replaces. Used by the benchmark to check frames do not allocate.
+    /// </summary>
+    class AllocationCounter
+    {
+    public:
+
+        /// <summary>
+        /// Allocations made by every thread since the program started
+        /// </summary>
+        static uint64_t get_count();
+
+        /// <summary>
+        /// Bytes requested by those allocations
+        /// </summary>
+        static uint64_t get_bytes();
+    };
+}
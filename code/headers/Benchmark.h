@@ -0,0 +1,140 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "View.h"
+
+namespace MGVisualizer
+{
+    using std::vector;
+
+    /// <summary>
+    /// Headless run of the view pipeline measuring frame and stage timings
+    /// </summary>
+    class Benchmark
+    {
+    private:
+
+        unsigned width;
+        unsigned height;
+        unsigned frames;
+
+        // Scene file rendered
+        std::string scenePath;
+
+        // Frames rendered before starting to measure
+        unsigned warmupFrames;
+
+        bool tiledRendering;
+        bool occlusionCulling;
+        bool levelsOfDetail;
+        bool fusedVertexStage;
+
+        // Replay the camera path after measuring and fail if any frame allocates
+        bool allocationCheck;
+
+        Rasterizer< View::Color_Buffer >::Fill_Modes    fillMode;
+        Rasterizer< View::Color_Buffer >::Depth_Formats depthFormat;
+        Rasterizer< View::Color_Buffer >::Shading_Modes shadingMode;
+
+    public:
+
+        /// <summary>
+        /// Create a benchmark rendering offscreen
+        /// </summary>
+        /// <param name="width">Color buffer width</param>
+        /// <param name="height">Color buffer height</param>
+        /// <param name="frames">Number of measured frames</param>
+        Benchmark(unsigned width, unsigned height, unsigned frames);
+
+        /// <summary>
+        /// Render every frame without a window and print results to standard output
+        /// </summary>
+        /// <returns>False if the scene could not be loaded, or the allocation check is enabled and a steady state frame allocated heap memory</returns>
+        bool run();
+
+        /// <summary>
+        /// Choose the scene file to render, the default scene otherwise
+        /// </summary>
+        void set_scene(const std::string& path) { scenePath = path; }
+
+        /// <summary>
+        /// Choose rasterizer backend to measure
+        /// </summary>
+        /// <param name="enabled">True for the tiled parallel backend, false for the serial one</param>
+        void set_tiled_rendering(bool enabled) { tiledRendering = enabled; }
+
+        /// <summary>
+        /// Enable rejecting hidden triangles and meshes with the hierarchical z-buffer
+        /// </summary>
+        void set_occlusion_culling(bool enabled) { occlusionCulling = enabled; }
+
+        /// <summary>
+        /// Enable switching distant meshes to simplified levels of detail
+        /// </summary>
+        void set_levels_of_detail(bool enabled) { levelsOfDetail = enabled; }
+
+        /// <summary>
+        /// Choose between the fused vertex stage and transforming and lighting vertices in separate passes
+        /// </summary>
+        void set_fused_vertex_stage(bool enabled) { fusedVertexStage = enabled; }
+
+        /// <summary>
+        /// Render the camera path a second time once every buffer has grown and require no heap allocation in it
+        /// </summary>
+        void set_allocation_check(bool enabled) { allocationCheck = enabled; }
+
+        /// <summary>
+        /// Choose the routine filling polygons
+        /// </summary>
+        void set_fill_mode(Rasterizer< View::Color_Buffer >::Fill_Modes mode) { fillMode = mode; }
+
+        /// <summary>
+        /// Choose the format of the depth buffer
+        /// </summary>
+        void set_depth_format(Rasterizer< View::Color_Buffer >::Depth_Formats format) { depthFormat = format; }
+
+        /// <summary>
+        /// Choose between flat and Gouraud shading
+        /// </summary>
+        void set_shading_mode(Rasterizer< View::Color_Buffer >::Shading_Modes mode) { shadingMode = mode; }
+
+        /// <summary>
+        /// Measure every supported span kernel on short and long spans and print results
+        /// </summary>
+        static void run_span_kernels();
+
+        /// <summary>
+        /// Measure every fill mode, depth format and shading mode on small, medium and large triangles and print results
+        /// </summary>
+        static void run_fill_modes();
+
+        /// <summary>
+        /// Measure how every depth format orders close surfaces at several distances from the camera and print results
+        /// </summary>
+        static void run_depth_formats();
+
+    private:
+
+        /// <summary>
+        /// Place camera along the scripted path
+        /// </summary>
+        /// <param name="camera">Camera to move</param>
+        /// <param name="frame">Index of the frame being rendered</param>
+        void move_camera(Camera& camera, unsigned frame);
+
+        static double percentile(const vector< double >& sorted_values, double fraction);
+
+        static const char* get_depth_format_name(Rasterizer< View::Color_Buffer >::Depth_Formats format);
+
+        /// <summary>
+        /// Hash of the color buffer contents to compare output between backends
+        /// </summary>
+        static unsigned checksum(const unsigned char* bytes, size_t size);
+    };
+}
@@ -95,5 +95,10 @@ namespace MGVisualizer
 		/// <param name="aspect_ratio">Aspect ratio of window</param>
 		/// <returns>Camera projection matrix</returns>
 		mat4 get_projection_matrix(float aspect_ratio);
+
+		/// <summary>
+		/// Distance from the camera to the near clipping plane
+		/// </summary>
+		float get_near_plane() const { return nearPlane; }
 	};
 }
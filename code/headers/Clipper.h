@@ -4,6 +4,8 @@
 // @miguelgutierrezruano
 // 2023
 
+#include <cstddef>
+#include <cstdint>
 #include <glm/glm.hpp>
 
 namespace MGVisualizer
@@ -11,25 +13,81 @@ namespace MGVisualizer
 
 	using namespace glm;
 
+	/// <summary>
+	/// Clips polygons in homogeneous clip space, before the perspective divide
+	/// </summary>
 	class Clipper
 	{
 
 	public:
 
 		/// <summary>
-		/// Clip vertices in an 800x600 window
+		/// Bits telling which planes a clip space vertex is outside of
 		/// </summary>
-		/// <param name="vertices">Pointer to first vertex of the polygon</param>
+		enum Codes : uint16_t
+		{
+			Near        = 1 << 0,
+			Far         = 1 << 1,
+
+			// Viewport borders
+			Left        = 1 << 2,
+			Right       = 1 << 3,
+			Bottom      = 1 << 4,
+			Top         = 1 << 5,
+
+			// Guard band borders
+			GuardLeft   = 1 << 6,
+			GuardRight  = 1 << 7,
+			GuardBottom = 1 << 8,
+			GuardTop    = 1 << 9,
+
+			/// Polygons outside any of these planes are not visible
+			RejectMask   = Near | Far | Left | Right | Bottom | Top,
+
+			/// Polygons outside any of these planes have to be clipped before rasterizing
+			ClipMask     = Near | Far | GuardLeft | GuardRight | GuardBottom | GuardTop,
+
+			/// Polygons outside any of these planes but inside the guard band are scissored while rasterizing
+			ViewportMask = Left | Right | Bottom | Top,
+		};
+
+		/// Clipped triangles never have more vertices than this
+		static constexpr int max_vertices = 10;
+
+	public:
+
+		/// <summary>
+		/// Compute outside codes of clip space vertices
+		/// </summary>
+		/// <param name="vertices">Pointer to first clip space vertex</param>
+		/// <param name="count">Number of vertices</param>
+		/// <param name="guard_band">Guard band size relative to the viewport, 1 means no guard band</param>
+		/// <param name="codes">Pointer to first code to write</param>
+		static void compute_codes(const vec4* vertices, size_t count, float guard_band, uint16_t* codes);
+
+		/// <summary>
+		/// Clip polygon against near, far and guard band planes
+		/// </summary>
+		/// <param name="vertices">Pointer to first clip space vertex of the polygon</param>
 		/// <param name="first_index">Pointer to the index of the first vertex</param>
-		/// <param name="last_index">Pointer to the index of the last vertex</param>
+		/// <param name="last_index">Pointer past the index of the last vertex</param>
+		/// <param name="planes">Codes of the planes to clip against</param>
+		/// <param name="guard_band">Guard band size relative to the viewport</param>
 		/// <param name="clipped_vertices">Pointer to first element of array where clipped vertices are going to be storaged</param>
 		/// <returns>Number of vertices of the clipped polygon</returns>
-		static int clip(const ivec4* vertices, int* first_index, int* last_index, ivec4* clipped_vertices, int width, int height);
+		static int clip(const vec4* vertices, const int* first_index, const int* last_index, unsigned planes, float guard_band, vec4* clipped_vertices);
 
-	private:
+		/// <summary>
+		/// Clip polygon against near, far and guard band planes interpolating a color for each new vertex
+		/// </summary>
+		/// <param name="colors">Pointer to the color of the first vertex, indexed like vertices</param>
+		/// <param name="clipped_colors">Pointer to first element of array where colors of clipped vertices are stored</param>
+		/// <returns>Number of vertices of the clipped polygon</returns>
+		static int clip(const vec4* vertices, const vec3* colors, const int* first_index, const int* last_index, unsigned planes, float guard_band,
+			vec4* clipped_vertices, vec3* clipped_colors);
 
-		static int clip_against_line(const ivec4* vertices, int* first_index, int* last_index, ivec4* clipped_vertices, float a, float b, float c);
-		static ivec4 line_intersection(float a, float b, float c, const ivec4& point0, const ivec4& point1);
+	private:
 
+		static int clip_against_plane(const vec4* vertices, const vec3* colors, int count, vec4* clipped_vertices, vec3* clipped_colors, const vec4& plane);
 	};
 }
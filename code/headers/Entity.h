@@ -5,15 +5,14 @@
 
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <Color_Buffer.hpp>
 #include "Transform.h"
 #include "Mesh.h"
-#include "Light.h"
-
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+#include "ModelCache.h"
+#include "FrameStats.h"
 
 namespace MGVisualizer
 {
@@ -22,6 +21,13 @@ namespace MGVisualizer
 	using argb::Rgb888;
 	using  std::vector;
 
+	/// <summary>
+	/// Index of an entity in the entity array of its view, stays valid while entities are added
+	/// </summary>
+	typedef uint32_t EntityHandle;
+
+	constexpr EntityHandle no_entity = EntityHandle(-1);
+
 	/// <summary>
 	/// Class to render models in the scene
 	/// </summary>
@@ -33,30 +39,78 @@ namespace MGVisualizer
 
 	private:
 
-		Entity* parent;
+		// Always stored before this entity, no_entity for roots
+		EntityHandle parent;
 
 		Transform transform;
 
-		// Mesh vectors foreach mesh of the model
-		vector < Mesh > meshes;
+		// Cached parent world matrix times transform matrix
+		mat4 worldMatrix;
+
+		// Incremented each time world matrix is recomputed
+		unsigned worldVersion;
+
+		// Parent world version used to compute world matrix
+		unsigned parentVersion;
+
+		// Projection times world matrix of the last update
+		mat4 clipMatrix;
+
+		// Meshes of the model, shared with every entity using the same file
+		std::shared_ptr< const ModelCache::Model > model;
+
+		// State of this entity drawing each mesh of the model
+		vector < MeshState > meshStates;
+
+		// Model finished loading and mesh states were created
+		bool ready;
 
 	public:
 
 		/// <summary>
-		/// Constructor of entity
+		/// Constructor of entity. Entity renders nothing until its model is loaded.
+		/// </summary>
+		/// <param name="entity_model">Model drawn by the entity, usually taken from a model cache</param>
+		/// <param name="parent_entity">Handle of the parent of this entity</param>
+		Entity(std::shared_ptr< const ModelCache::Model > entity_model, EntityHandle parent_entity = no_entity);
+
+		// Entities live in a contiguous array, they are moved but never copied
+		Entity(Entity&&) = default;
+		Entity& operator = (Entity&&) = default;
+
+		Entity(const Entity&) = delete;
+		Entity& operator = (const Entity&) = delete;
+
+		/// <summary>
+		/// Check if model finished loading
 		/// </summary>
-		/// <param name="model_path">Path to 3D file</param>
-		/// <param name="parent_entity">Parent of this entity</param>
-		Entity(const char* model_path, Entity* parent_entity = nullptr);
+		bool is_loaded() const { return ready || model->is_loaded(); }
 
 		Transform* get_transform() { return &transform; }
-		Entity* get_parent() { return parent; }
+		EntityHandle get_parent() const { return parent; }
+
+		const mat4& get_world_matrix() const { return worldMatrix; }
+
+		/// <summary>
+		/// Meshes of the model, only valid once it is loaded
+		/// </summary>
+		const vector< Mesh >& get_meshes() const { return model->meshes; }
+
+		const std::shared_ptr< const ModelCache::Model >& get_model() const { return model; }
+
+		/// <summary>
+		/// Recompute world matrix if this entity or its parent changed
+		/// </summary>
+		/// <param name="parent_entity">Parent, already updated this frame, or null for roots</param>
+		/// <param name="stats">Stats where recomputed matrices are counted</param>
+		void update_world_matrix(const Entity* parent_entity, FrameStats& stats);
 
 		/// <summary>
 		/// Update position and normals of entity
 		/// </summary>
 		/// <param name="projection">Projection matrix of the main camera</param>
-		void update(mat4 projection);
+		/// <param name="view">View giving guard band, level of detail thresholds and frame stats</param>
+		void update(mat4 projection, View* view);
 
 		/// <summary>
 		/// Render entity in given view
@@ -67,15 +121,31 @@ namespace MGVisualizer
 
 	private:
 
-		mat4 get_parent_matrix();
-
-		void load_model_nodes(const char* model_path);
-
-		Color compute_lightning(const Color& vertexColor, const vec4& vertex, const vec4& normal, vector< Light* >& lights);
+		/// <summary>
+		/// Create mesh states once the model is loaded
+		/// </summary>
+		/// <returns>True if entity can draw its meshes</returns>
+		bool acquire_meshes();
 
-		void copy_nodes_recursive(aiNode* node, const aiScene* scene, aiMatrix4x4 parentTransform);
-		void copy_meshes(aiNode* node, const aiScene* scene, aiMatrix4x4 parentTransform);
+		/// <summary>
+		/// Fused vertex stage. Reads positions of the selected level of detail once and writes clip codes and
+		/// display vertices, a block of vertices at a time so clip space vertices never reach memory.
+		/// </summary>
+		/// <param name="mesh">Visible mesh</param>
+		/// <param name="state">State of the mesh in this entity, receiving the streams</param>
+		/// <param name="viewport">Matrix from normalized device coordinates to display coordinates</param>
+		/// <param name="view">View giving guard band and depth format</param>
+		void process_vertices(const Mesh& mesh, MeshState& state, const mat4& viewport, View* view);
 
-		mat4 aiToGlm(const aiMatrix4x4& from);
+		/// <summary>
+		/// Light vertices referenced by visible triangles, a block at a time so world normals never reach memory
+		/// </summary>
+		/// <param name="mesh">Visible mesh</param>
+		/// <param name="state">State of the mesh in this entity, receiving the computed colors</param>
+		/// <param name="normal_matrix">Matrix from mesh normals to world normals</param>
+		/// <param name="vertices">Indices of the vertices to light, each one once</param>
+		/// <param name="count">Number of vertices to light</param>
+		/// <param name="view">View giving the lights</param>
+		void light_vertices(const Mesh& mesh, MeshState& state, const mat3& normal_matrix, const int* vertices, size_t count, View* view);
 	};
 }
\ No newline at end of file
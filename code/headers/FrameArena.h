@@ -0,0 +1,79 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace MGVisualizer
+{
+    using std::vector;
+
+    /// <summary>
+    /// Bump allocator for data living until the end of the frame. Everything is released at once by reset.
+    /// Requests not fitting its block are served from the heap and the block grows on the next reset,
+    /// so frames needing no more memory than a previous one do not touch the heap.
+    /// Not thread safe, it is only used from the thread running update and render.
+    /// </summary>
+    class FrameArena
+    {
+    public:
+
+        static constexpr size_t alignment = 16;
+
+    private:
+
+        std::unique_ptr< unsigned char[] > block;
+        size_t                             capacity;
+        size_t                             used;
+
+        // Bytes requested since the last reset, including those served from the heap
+        size_t requested;
+
+        // Largest number of bytes requested in one frame
+        size_t peak;
+
+        // Requests that did not fit in the block this frame
+        vector< std::unique_ptr< unsigned char[] > > overflow;
+
+    public:
+
+        /// <summary>
+        /// Create arena
+        /// </summary>
+        /// <param name="initial_capacity">Bytes reserved up front</param>
+        FrameArena(size_t initial_capacity = 1 << 20);
+
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator = (const FrameArena&) = delete;
+
+        /// <summary>
+        /// Uninitialized array valid until the next reset
+        /// </summary>
+        /// <param name="count">Number of elements</param>
+        template< typename TYPE >
+        TYPE* allocate(size_t count)
+        {
+            return static_cast< TYPE* >(allocate_bytes(count * sizeof(TYPE)));
+        }
+
+        /// <summary>
+        /// Release every allocation of the frame and grow the block if the frame overflowed it
+        /// </summary>
+        void reset();
+
+        size_t get_capacity() const { return capacity; }
+
+        size_t get_used() const { return requested; }
+
+        size_t get_peak() const { return peak; }
+
+    private:
+
+        void* allocate_bytes(size_t size);
+    };
+}
@@ -0,0 +1,160 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace MGVisualizer
+{
+    /// <summary>
+    /// Timings and counters gathered while updating and rendering one frame
+    /// </summary>
+    class FrameStats
+    {
+    public:
+
+        typedef std::chrono::high_resolution_clock Clock;
+
+        /// <summary>
+        /// Stages of the render pipeline that are timed separately
+        /// </summary>
+        enum Stages
+        {
+            VertexTransform,
+            Lighting,
+            Clipping,
+            Rasterization,
+
+            StagesCount
+        };
+
+    public:
+
+        /// Milliseconds spent in each stage during the frame
+        double stageTimes[StagesCount];
+
+        /// Entity world matrices recomputed during the frame
+        unsigned matricesRecomputed;
+
+        /// Meshes outside the view frustum, neither transformed nor rendered
+        unsigned meshesCulled;
+
+        /// Meshes intersecting the view frustum
+        unsigned meshesVisible;
+
+        /// Meshes hidden behind already rasterized geometry
+        unsigned meshesOccluded;
+
+        /// Polygons rejected by the hierarchical z-buffer, once per tile when rasterizing in tiles
+        unsigned trianglesOccluded;
+
+        /// Estimated pixels those polygons would have covered
+        uint64_t pixelsOccluded;
+
+        /// Triangles of the levels of detail selected for visible meshes
+        unsigned trianglesSelected;
+
+        /// Triangles visible meshes have at full detail
+        unsigned trianglesFullDetail;
+
+        /// Vertices of the selected levels of detail of meshes rendered, neither culled nor occluded
+        unsigned verticesRendered;
+
+        /// Vertices lit and transformed to display coordinates
+        unsigned verticesLit;
+
+        /// Vertices of rendered meshes not used by any visible triangle, only the fused vertex stage lights them
+        unsigned verticesSkipped;
+
+        /// Bytes of vertex streams the vertex stage reads from meshes and the frame arena
+        uint64_t vertexBytesRead;
+
+        /// Bytes of vertex streams the vertex stage writes to the frame arena
+        uint64_t vertexBytesWritten;
+
+        /// Triangles facing away from the camera
+        unsigned trianglesBackfacing;
+
+        /// Triangles outside the view volume
+        unsigned trianglesRejected;
+
+        /// Triangles rasterized directly, completely inside the viewport
+        unsigned trianglesInside;
+
+        /// Triangles rasterized directly with scissoring, inside the guard band
+        unsigned trianglesScissored;
+
+        /// Triangles clipped against near, far or guard band planes
+        unsigned trianglesClipped;
+
+        /// Bytes of transient data taken from the frame arena
+        size_t arenaBytes;
+
+    public:
+
+        FrameStats() { reset(); }
+
+        /// <summary>
+        /// Clear every timing and counter before a new frame
+        /// </summary>
+        void reset()
+        {
+            for (int i = 0; i < StagesCount; i++)
+                stageTimes[i] = 0.0;
+
+            matricesRecomputed = 0;
+
+            meshesCulled = 0;
+            meshesVisible = 0;
+            meshesOccluded = 0;
+
+            trianglesOccluded = 0;
+            pixelsOccluded = 0;
+
+            trianglesSelected = 0;
+            trianglesFullDetail = 0;
+
+            verticesRendered = 0;
+            verticesLit = 0;
+            verticesSkipped = 0;
+
+            vertexBytesRead = 0;
+            vertexBytesWritten = 0;
+
+            trianglesBackfacing = 0;
+            trianglesRejected = 0;
+            trianglesInside = 0;
+            trianglesScissored = 0;
+            trianglesClipped = 0;
+
+            arenaBytes = 0;
+        }
+
+        /// <summary>
+        /// Add time elapsed since start to given stage
+        /// </summary>
+        /// <param name="stage">Stage to accumulate time in</param>
+        /// <param name="start">Time point where the measured work started</param>
+        void add_time(Stages stage, Clock::time_point start)
+        {
+            stageTimes[stage] += std::chrono::duration< double, std::milli >(Clock::now() - start).count();
+        }
+
+        static const char* get_stage_name(Stages stage)
+        {
+            switch (stage)
+            {
+                case VertexTransform: return "vertex transform";
+                case Lighting:        return "lighting";
+                case Clipping:        return "clipping";
+                case Rasterization:   return "rasterization";
+                default:              return "unknown";
+            }
+        }
+    };
+}
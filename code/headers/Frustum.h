@@ -0,0 +1,47 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace MGVisualizer
+{
+    using namespace glm;
+
+    /// <summary>
+    /// View volume planes extracted from a projection matrix, used to cull whole meshes
+    /// </summary>
+    class Frustum
+    {
+    private:
+
+        // Left, right, bottom, top, near and far planes, normals pointing inside
+        vec4 planes[6];
+
+    public:
+
+        /// <summary>
+        /// Extract planes of the volume a matrix maps to clip space. Planes are in the
+        /// space the matrix transforms from, so a model view projection matrix gives model space planes.
+        /// </summary>
+        /// <param name="matrix">Matrix transforming to clip space</param>
+        explicit Frustum(const mat4& matrix);
+
+        /// <summary>
+        /// Check if a sphere is at least partially inside the frustum
+        /// </summary>
+        /// <param name="center">Center of the sphere</param>
+        /// <param name="radius">Radius of the sphere</param>
+        bool intersects_sphere(const vec3& center, float radius) const;
+
+        /// <summary>
+        /// Check if an axis aligned box may be partially inside the frustum
+        /// </summary>
+        /// <param name="min_corner">Corner with lowest coordinates</param>
+        /// <param name="max_corner">Corner with highest coordinates</param>
+        bool intersects_box(const vec3& min_corner, const vec3& max_corner) const;
+    };
+}
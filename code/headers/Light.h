@@ -25,8 +25,6 @@ namespace MGVisualizer
 		{
 			Ambient, 
 			Directional,
-
-			// TODO: Do point light
 			Point
 		};
 
@@ -56,11 +54,6 @@ namespace MGVisualizer
 			color = { 1.f, 1.f, 1.f };
 			intensity = 1;
 		}
-
-	private:
-
-		// Virtual method needed to make casts
-		virtual void illuminate() { }
 	};
 }
 
@@ -0,0 +1,112 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Light.h"
+#include "Mesh.h"
+#include "FrameArena.h"
+
+namespace MGVisualizer
+{
+    using namespace glm;
+    using std::vector;
+
+    /// <summary>
+    /// Lights of the scene flattened once per frame and grouped by type, so vertices are
+    /// lit without casts or type switches, one light at a time over many vertices
+    /// </summary>
+    class LightTable
+    {
+    public:
+
+        // Vertices lit at once by the fused vertex stage
+        static constexpr size_t block_size = 64;
+
+    private:
+
+        struct Directional
+        {
+            vec3 direction;
+            vec3 color;
+        };
+
+        struct Point
+        {
+            vec3  position;
+            vec3  color;
+            float inverse_range2;
+        };
+
+    private:
+
+        // Sum of every ambient light
+        vec3 ambient;
+
+        // Color is premultiplied by intensity and normalized to [0, 1]
+        vector< Directional > directionals;
+        vector< Point >       points;
+
+        // Vertices being lit, one stream per component, allocated in the frame arena or pointing to block
+        float* positions_x, * positions_y, * positions_z;
+        float* normals_x, * normals_y, * normals_z;
+        float* red, * green, * blue;
+
+        // Streams of a block of consecutive vertices, small enough to stay in cache
+        alignas(16) float block[9][block_size];
+
+    public:
+
+        LightTable()
+            :
+            ambient(0.f),
+            positions_x(nullptr), positions_y(nullptr), positions_z(nullptr),
+            normals_x(nullptr), normals_y(nullptr), normals_z(nullptr),
+            red(nullptr), green(nullptr), blue(nullptr)
+        { }
+
+        /// <summary>
+        /// Rebuild table from scene lights
+        /// </summary>
+        /// <param name="lights">Lights of the scene</param>
+        void compile(const vector< Light* >& lights);
+
+        /// <summary>
+        /// Point lights need world positions of the vertices they light
+        /// </summary>
+        bool has_point_lights() const { return not points.empty(); }
+
+        /// <summary>
+        /// Compute color of mesh vertices referenced by visible triangles
+        /// </summary>
+        /// <param name="mesh">Mesh being lit</param>
+        /// <param name="state">State of the mesh with world normals ready, receiving computed colors</param>
+        /// <param name="world_matrix">Matrix from mesh coordinates to world</param>
+        /// <param name="vertices">Indices of the vertices to light, each one once</param>
+        /// <param name="count">Number of vertices to light</param>
+        /// <param name="arena">Arena holding the streams of the vertices being lit</param>
+        void illuminate(const Mesh& mesh, MeshState& state, const mat4& world_matrix, const int* vertices, size_t count, FrameArena& arena);
+
+        /// <summary>
+        /// Compute color of a block of mesh vertices whose world normals were just transformed
+        /// </summary>
+        /// <param name="mesh">Mesh being lit</param>
+        /// <param name="state">State of the mesh whose computed colors are written</param>
+        /// <param name="world_matrix">Matrix from mesh coordinates to world</param>
+        /// <param name="normals">World normal of each vertex in the block</param>
+        /// <param name="vertices">Indices of the vertices in the block</param>
+        /// <param name="count">Number of vertices, not more than block_size</param>
+        void illuminate_block(const Mesh& mesh, MeshState& state, const mat4& world_matrix, const vec4* normals, const int* vertices, size_t count);
+
+    private:
+
+        void add_lights(size_t count);
+
+        void add_directional(const Directional& light, size_t count);
+        void add_point(const Point& light, size_t count);
+    };
+}
@@ -5,15 +5,20 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vector>
 #include <Color_Buffer.hpp>
-
-#include "Transform.h"
+#include <glm/glm.hpp>
 
 namespace MGVisualizer
 {
 	using argb::Rgb888;
 	using  std::vector;
+	using glm::vec3;
+	using glm::vec4;
+	using glm::ivec4;
 
 	/// <summary>
 	/// Data container of every attributes a model needs to be rendered
@@ -27,14 +32,24 @@ namespace MGVisualizer
 	public:
 
 		/// <summary>
-		/// Transform of mesh
+		/// Simplified version of the mesh using its first vertices
 		/// </summary>
-		Transform transform;
+		struct Lod
+		{
+			vector < int > indices;
+
+			// Vertices below this one are enough to render the level
+			uint32_t vertex_count;
+		};
+
+	public:
 
 		/// <summary>
-		/// Model coordinates vertices
+		/// Model coordinates vertices, one stream per component
 		/// </summary>
-		vector <  vec4 > original_vertices;
+		vector < float > positions_x;
+		vector < float > positions_y;
+		vector < float > positions_z;
 
 		/// <summary>
 		/// Indices to give vertex their connections
@@ -42,37 +57,211 @@ namespace MGVisualizer
 		vector <   int > original_indices;
 
 		/// <summary>
-		/// Original color of each vertex
+		/// Coarser levels of detail, each one about half the triangles of the previous one
+		/// </summary>
+		vector <   Lod > lods;
+
+		/// <summary>
+		/// Diffuse color of the material, shared by every vertex
+		/// </summary>
+		Color material_color;
+
+		/// <summary>
+		/// Model coordinates normals, octahedral encoded
+		/// </summary>
+		vector < uint32_t > normals;
+
+		/// <summary>
+		/// Vertex cache miss ratio of indices in the order they were imported
+		/// </summary>
+		float imported_acmr;
+
+		/// <summary>
+		/// Model space bounding box
+		/// </summary>
+		vec3 bounds_min;
+		vec3 bounds_max;
+
+		/// <summary>
+		/// Model space bounding sphere
+		/// </summary>
+		vec3  sphere_center;
+		float sphere_radius;
+
+	public:
+
+		Mesh() : imported_acmr(0.f), bounds_min(0.f), bounds_max(0.f), sphere_center(0.f), sphere_radius(0.f) { }
+
+		// Streams can take megabytes, meshes are only moved so copies do not happen by accident
+		Mesh(const Mesh&) = delete;
+		Mesh& operator = (const Mesh&) = delete;
+
+		Mesh(Mesh&&) = default;
+		Mesh& operator = (Mesh&&) = default;
+
+		size_t get_vertex_count() const { return positions_x.size(); }
+
+		/// <summary>
+		/// Indices of a level of detail
+		/// </summary>
+		/// <param name="lod">Level of detail, 0 is the original mesh</param>
+		const vector< int >& get_lod_indices(unsigned lod) const
+		{
+			return lod == 0 ? original_indices : lods[lod - 1].indices;
+		}
+
+		/// <summary>
+		/// Number of first vertices used by a level of detail
+		/// </summary>
+		/// <param name="lod">Level of detail, 0 is the original mesh</param>
+		size_t get_lod_vertex_count(unsigned lod) const
+		{
+			return lod == 0 ? get_vertex_count() : lods[lod - 1].vertex_count;
+		}
+
+		/// <summary>
+		/// Resize every vertex and index vector
+		/// </summary>
+		/// <param name="vertices_number">Number of vertices</param>
+		/// <param name="indices_number">Number of indices</param>
+		void resize(size_t vertices_number, size_t indices_number)
+		{
+			positions_x.resize(vertices_number);
+			positions_y.resize(vertices_number);
+			positions_z.resize(vertices_number);
+			normals.resize(vertices_number);
+
+			original_indices.resize(indices_number);
+		}
+
+		/// <summary>
+		/// Bytes taken by vertex streams
 		/// </summary>
-		vector < Color > original_colors;
+		size_t get_vertex_bytes() const
+		{
+			return (positions_x.capacity() + positions_y.capacity() + positions_z.capacity()) * sizeof(float) +
+				normals.capacity() * sizeof(uint32_t);
+		}
 
 		/// <summary>
-		/// Model coordinates normals
+		/// Bytes taken by indices of every level of detail
 		/// </summary>
-		vector <  vec4 > original_normals;
+		size_t get_index_bytes() const
+		{
+			size_t indices = original_indices.capacity();
+
+			for (const Lod& level : lods)
+				indices += level.indices.capacity();
+
+			return indices * sizeof(int);
+		}
 
 		/// <summary>
-		/// Projected vertices
+		/// Compute bounding box and sphere enclosing every position
 		/// </summary>
-		vector <  vec4 > transformed_vertices;
+		void compute_bounds()
+		{
+			size_t count = get_vertex_count();
+
+			if (count == 0)
+			{
+				bounds_min = bounds_max = sphere_center = vec3(0.f);
+				sphere_radius = 0.f;
+				return;
+			}
+
+			bounds_min = bounds_max = vec3(get_position(0));
+
+			for (size_t index = 1; index < count; index++)
+			{
+				vec3 position = vec3(get_position(index));
+
+				bounds_min = glm::min(bounds_min, position);
+				bounds_max = glm::max(bounds_max, position);
+			}
+
+			// Sphere around box center, radius from the furthest vertex so it is tighter than the box diagonal
+			sphere_center = (bounds_min + bounds_max) * 0.5f;
+
+			float radius2 = 0.f;
+
+			for (size_t index = 0; index < count; index++)
+			{
+				vec3 offset = vec3(get_position(index)) - sphere_center;
+
+				radius2 = std::max(radius2, glm::dot(offset, offset));
+			}
+
+			sphere_radius = std::sqrt(radius2);
+		}
+
+		/// <summary>
+		/// Get model coordinates of a vertex
+		/// </summary>
+		/// <param name="index">Index of the vertex</param>
+		/// <returns>Vertex position with w = 1</returns>
+		vec4 get_position(size_t index) const
+		{
+			return vec4(positions_x[index], positions_y[index], positions_z[index], 1.f);
+		}
+	};
+
+	/// <summary>
+	/// State of a mesh drawn by one entity during the current frame. Meshes are shared by every
+	/// entity using the same model, so whatever depends on the entity transform is kept here.
+	/// </summary>
+	struct MeshState
+	{
+		typedef Rgb888 Color;
+
+		/// <summary>
+		/// Level of detail rendered this frame, 0 is the original mesh
+		/// </summary>
+		unsigned lod;
+
+		/// <summary>
+		/// Mesh intersects the view frustum this frame
+		/// </summary>
+		bool visible;
+
+		// Streams below are only written for visible meshes. They are taken from the frame arena,
+		// sized for the selected level of detail and valid until the arena is reset.
+
+		/// <summary>
+		/// Clip space vertices, before the perspective divide
+		/// </summary>
+		vec4*     transformed_vertices;
+
+		/// <summary>
+		/// Planes each clip space vertex is outside of
+		/// </summary>
+		uint16_t* clip_codes;
 
 		/// <summary>
 		/// World space normals
 		/// </summary>
-		vector <  vec4 > transformed_normals;
+		vec4*     transformed_normals;
 
 		/// <summary>
 		/// View space vertices
 		/// </summary>
-		vector < ivec4 > display_vertices;
+		ivec4*    display_vertices;
 
 		/// <summary>
 		/// Colors after applying illumination
 		/// </summary>
-		vector < Color > computed_colors;
+		Color*    computed_colors;
 
-	public:
+		/// <summary>
+		/// Vertex is already referenced by a visible triangle this frame
+		/// </summary>
+		uint8_t*  vertex_referenced;
 
-		Mesh() { }
+		MeshState()
+			:
+			lod(0), visible(false),
+			transformed_vertices(nullptr), clip_codes(nullptr), transformed_normals(nullptr),
+			display_vertices(nullptr), computed_colors(nullptr), vertex_referenced(nullptr)
+		{ }
 	};
 }
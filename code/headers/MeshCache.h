@@ -0,0 +1,47 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+namespace MGVisualizer
+{
+    using std::vector;
+
+    /// <summary>
+    /// On disk cache of the meshes flattened from a model file
+    /// </summary>
+    class MeshCache
+    {
+    public:
+
+        /// <summary>
+        /// Get path of the cache file that belongs to a model
+        /// </summary>
+        /// <param name="model_path">Path to 3D file</param>
+        static std::string get_cache_path(const char* model_path);
+
+        /// <summary>
+        /// Load meshes from the cache file if it matches the model file and import flags
+        /// </summary>
+        /// <param name="model_path">Path to 3D file</param>
+        /// <param name="import_flags">Assimp post process flags used to import the model</param>
+        /// <param name="meshes">Vector where loaded meshes are appended</param>
+        /// <returns>False if there is no valid cache and the model has to be imported</returns>
+        static bool load(const char* model_path, unsigned import_flags, vector< Mesh >& meshes);
+
+        /// <summary>
+        /// Write meshes imported from a model file to its cache file
+        /// </summary>
+        /// <param name="model_path">Path to 3D file</param>
+        /// <param name="import_flags">Assimp post process flags used to import the model</param>
+        /// <param name="meshes">Meshes with node transforms already applied</param>
+        /// <returns>True if the cache file was written</returns>
+        static bool save(const char* model_path, unsigned import_flags, const vector< Mesh >& meshes);
+    };
+}
@@ -0,0 +1,50 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "Mesh.h"
+
+namespace MGVisualizer
+{
+    using std::vector;
+
+    /// <summary>
+    /// Load time passes reordering mesh data so vertices are accessed close together while rendering
+    /// </summary>
+    class MeshOptimizer
+    {
+    public:
+
+        /// Vertex cache size simulated when reordering and measuring
+        static constexpr unsigned cache_size = 16;
+
+        /// <summary>
+        /// Reorder triangles so they reuse recently used vertices (Tipsify). Winding is kept.
+        /// </summary>
+        /// <param name="indices">Triangle list indices, reordered in place</param>
+        /// <param name="vertex_count">Number of vertices indices refer to</param>
+        static void optimize_vertex_cache(vector< int >& indices, size_t vertex_count);
+
+        /// <summary>
+        /// Reorder vertex streams by first use in the indices and remap indices to match.
+        /// Levels of detail are visited from the coarsest, so each one uses a prefix of the
+        /// vertices. Vertices no triangle uses are moved to the end.
+        /// </summary>
+        /// <param name="mesh">Mesh with its model streams and indices filled</param>
+        static void optimize_vertex_fetch(Mesh& mesh);
+
+        /// <summary>
+        /// Average cache miss ratio, vertices transformed per triangle with a FIFO vertex cache
+        /// </summary>
+        /// <param name="indices">Pointer to first index</param>
+        /// <param name="index_count">Number of indices</param>
+        /// <param name="vertex_count">Number of vertices indices refer to</param>
+        /// <returns>Between 0.5 for ideal meshes and 3</returns>
+        static float compute_acmr(const int* indices, size_t index_count, size_t vertex_count);
+    };
+}
@@ -0,0 +1,48 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "Mesh.h"
+
+namespace MGVisualizer
+{
+    using std::vector;
+
+    /// <summary>
+    /// Quadric error mesh simplification collapsing edges into one of their vertices,
+    /// so coarser levels of detail reuse the vertices of the mesh
+    /// </summary>
+    class MeshSimplifier
+    {
+    public:
+
+        /// Levels of detail generated besides the original indices
+        static constexpr unsigned max_lods = 3;
+
+        /// Meshes with fewer triangles are not simplified further
+        static constexpr size_t min_triangles = 64;
+
+    public:
+
+        /// <summary>
+        /// Simplify a triangle list until it has target triangles or no edge can collapse
+        /// without folding triangles. Border and seam vertices never move.
+        /// </summary>
+        /// <param name="mesh">Mesh whose positions are used</param>
+        /// <param name="indices">Triangle list to simplify</param>
+        /// <param name="target_triangles">Number of triangles wanted</param>
+        /// <returns>Simplified triangle list</returns>
+        static vector< int > simplify(const Mesh& mesh, const vector< int >& indices, size_t target_triangles);
+
+        /// <summary>
+        /// Fill mesh levels of detail, each one with about half the triangles of the previous one
+        /// </summary>
+        /// <param name="mesh">Mesh with its original indices optimized</param>
+        static void build_lods(Mesh& mesh);
+    };
+}
@@ -0,0 +1,90 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+namespace MGVisualizer
+{
+	using  std::map;
+	using  std::vector;
+	using glm::mat4;
+
+	/// <summary>
+	/// Models loaded by the scene, keyed by path so every entity using the same file shares its meshes
+	/// </summary>
+	class ModelCache
+	{
+	public:
+
+		/// <summary>
+		/// Meshes of one model file. Filled by a loader thread and never modified once loaded.
+		/// </summary>
+		struct Model
+		{
+			std::string path;
+
+			vector < Mesh > meshes;
+
+			// Set by loader thread once meshes is complete
+			std::atomic< bool > done;
+
+			Model(const std::string& model_path) : path(model_path), done(false) { }
+
+			bool is_loaded() const { return done.load(std::memory_order_acquire); }
+		};
+
+	private:
+
+		// Pool running the loads
+		ThreadPool& loader;
+
+		map< std::string, std::shared_ptr< Model > > models;
+
+	public:
+
+		/// <summary>
+		/// Create empty cache
+		/// </summary>
+		/// <param name="loader_pool">Pool where models are loaded in background</param>
+		ModelCache(ThreadPool& loader_pool) : loader(loader_pool) { }
+
+		ModelCache(const ModelCache&) = delete;
+		ModelCache& operator = (const ModelCache&) = delete;
+
+		/// <summary>
+		/// Model of a file, its load starts in background the first time the file is requested
+		/// </summary>
+		/// <param name="model_path">Path to 3D file</param>
+		std::shared_ptr< const Model > get(const std::string& model_path);
+
+		const map< std::string, std::shared_ptr< Model > >& get_models() const { return models; }
+
+	private:
+
+		static void load_model_nodes(const char* model_path, vector< Mesh >& target);
+
+		/// <summary>
+		/// Meshes the node and its descendants reference, counting meshes shared by several nodes once per node
+		/// </summary>
+		static size_t count_node_meshes(const aiNode* node);
+
+		static void copy_nodes_recursive(aiNode* node, const aiScene* scene, aiMatrix4x4 parentTransform, vector< Mesh >& target);
+		static void copy_meshes(aiNode* node, const aiScene* scene, aiMatrix4x4 parentTransform, vector< Mesh >& target);
+
+		static mat4 aiToGlm(const aiMatrix4x4& from);
+	};
+}
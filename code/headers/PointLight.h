@@ -0,0 +1,49 @@
+
+#pragma once
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include <glm/glm.hpp>
+#include "Light.h"
+
+namespace MGVisualizer
+{
+	/// <summary>
+	/// Light emitted from a position in every direction, fading with distance
+	/// </summary>
+	class PointLight : public Light
+	{
+
+	private:
+
+		glm::vec3 position;
+
+		// Distance where intensity is halved
+		float range;
+
+	public:
+
+		/// <summary>
+		/// Constructor of point light
+		/// </summary>
+		/// <param name="initialPosition">World position of the light</param>
+		/// <param name="initialRange">Distance where intensity is halved</param>
+		PointLight(glm::vec3 initialPosition, float initialRange)
+		{
+			type = Point;
+
+			position = initialPosition;
+			range = initialRange;
+		}
+
+	public:
+
+		glm::vec3 get_position() { return position; }
+		float     get_range   () { return range; }
+
+		void set_position(glm::vec3 newPosition) { position = newPosition; }
+		void set_range(float newRange) { range = newRange; }
+	};
+}
@@ -8,11 +8,16 @@
 
 #include <algorithm>
 #include <ciso646>
+#include <cmath>
 #include <cstdint>
 #include <limits>
+#include <type_traits>
+#include <vector>
 
 #include <glm/glm.hpp>
 
+#include "SpanFiller.h"
+
 using namespace glm;
 
 namespace MGVisualizer
@@ -26,27 +31,177 @@ namespace MGVisualizer
         typedef COLOR_BUFFER_TYPE            Color_Buffer;
         typedef typename Color_Buffer::Color Color;
 
+        // Memoria donde se cachean los lados del polgono para cada scanline. Cada hilo que
+        // rellene polgonos a la vez necesita la suya. Se reservan margin scanlines por encima
+        // y por debajo del color buffer para los polgonos que ocupan la guard band:
+
+        struct Edge_Cache
+        {
+            std::vector< int > offset0;
+            std::vector< int > offset1;
+            std::vector< int > z0;
+            std::vector< int > z1;
+
+            // Profundidades de los lados cuando el z-buffer guarda float invertido:
+
+            std::vector< float > depth0;
+            std::vector< float > depth1;
+
+            // Componentes del color de los lados en punto fijo 8.16 con sombreado Gouraud:
+
+            std::vector< int > color0[3];
+            std::vector< int > color1[3];
+
+            // Entrada que corresponde a la scanline 0:
+
+            int origin = 0;
+
+            // Polgonos descartados por el z-buffer jerrquico y pxeles que habran cubierto
+            // (estimados a partir de su rea):
+
+            unsigned occluded_polygons = 0;
+            uint64_t occluded_pixels = 0;
+
+            Edge_Cache() = default;
+
+            explicit Edge_Cache(unsigned lines, unsigned margin = 0)
+            {
+                resize(lines, margin);
+            }
+
+            void resize(unsigned lines, unsigned margin = 0)
+            {
+                // interpolate() puede escribir una entrada ms all de la ltima scanline:
+
+                size_t size = lines + 2 * size_t(margin) + 2;
+
+                offset0.resize(size);
+                offset1.resize(size);
+                z0.resize(size);
+                z1.resize(size);
+                depth0.resize(size);
+                depth1.resize(size);
+
+                for (int component = 0; component < 3; component++)
+                {
+                    color0[component].resize(size);
+                    color1[component].resize(size);
+                }
+
+                origin = int(margin);
+            }
+        };
+
+        // Rectngulo [x0, x1) x [y0, y1) fuera del cual no se escriben pxeles:
+
+        struct Scissor
+        {
+            int x0, y0;
+            int x1, y1;
+        };
+
+        // Lado de los bloques del z-buffer jerrquico, que tambin recorre el rasterizador
+        // por semiespacios:
+
+        static constexpr int z_block_size = 8;
+
+        // Bits de precisin subpxel de las coordenadas X e Y que recibe el rasterizador por
+        // semiespacios:
+
+        static constexpr int subpixel_bits = 8;
+
+        // Rutinas con las que se pueden rellenar los polgonos con z-buffer:
+
+        enum Fill_Modes
+        {
+            SCANLINE_FILL,      // Vrtices en pxeles, lados interpolados por scanline
+            HALF_SPACE_FILL     // Vrtices en punto fijo 24.8, funciones de arista por bloques de 8x8
+        };
+
+        // Formatos en los que se guarda la profundidad. En ambos los valores del z-buffer son
+        // enteros menores cuanto ms cerca estn, as que el z-buffer jerrquico y los kernels
+        // de spans los comparan igual:
+
+        enum Depth_Formats
+        {
+            FIXED_24_DEPTH,         // Z en [0, 1] con 24 bits, ms 6 bits fraccionarios para interpolarla
+            FLOAT_REVERSED_DEPTH    // near / w como float de 32 bits, con la misma precisin relativa a cualquier distancia
+        };
+
+        static constexpr int fixed_depth_bits = 24;
+        static constexpr int fixed_depth_fraction_bits = 6;
+
+        // Formas de dar color a los pxeles de un polgono:
+
+        enum Shading_Modes
+        {
+            FLAT_SHADING,           // Un color por polgono
+            GOURAUD_SHADING         // Colores de los vrtices interpolados
+        };
+
+        // Polticas de sombreado con las que se instancian las rutinas de relleno. Cada una se
+        // compila por separado, as que el relleno plano no paga nada por el interpolado:
+
+        struct Flat_Shading
+        {
+            static constexpr bool interpolates_colors = false;
+        };
+
+        struct Gouraud_Shading
+        {
+            static constexpr bool interpolates_colors = true;
+        };
+
     private:
 
         Color_Buffer& color_buffer;
 
-        static int offset_cache0[2160];
-        static int offset_cache1[2160];
+        Edge_Cache edge_cache;
+
+        // Kernel que rellena los spans cuando el color es Rgb888:
+
+        SpanFiller::Function          span_filler;
+        SpanFiller::Reversed_Function reversed_span_filler;
 
-        static int z_cache0[2160];
-        static int z_cache1[2160];
+        Fill_Modes    fill_mode;
+        Depth_Formats depth_format;
+        Shading_Modes shading_mode;
+
+        float near_plane;
 
         Color color;
 
         std::vector< int > z_buffer;
 
+        // Z-buffer jerrquico con la Z ms lejana de cada bloque de 8x8 pxeles. Solo puede
+        // quedarse por encima del valor real, as que los bloques en los que se escribe se
+        // marcan como sucios y se recalculan la prxima vez que se consultan:
+
+        std::vector< int >     z_block_max;
+        std::vector< uint8_t > z_block_dirty;
+        int                    z_blocks_x;
+        int                    z_blocks_y;
+        bool                   hierarchical_z;
+
     public:
 
         Rasterizer(Color_Buffer& target)
             :
             color_buffer(target),
-            z_buffer(target.get_width()* target.get_height())
+            edge_cache(target.get_height()),
+            span_filler(SpanFiller::get_function(SpanFiller::get_best_kernel())),
+            reversed_span_filler(SpanFiller::get_reversed_function(SpanFiller::get_best_kernel())),
+            fill_mode(SCANLINE_FILL),
+            depth_format(FIXED_24_DEPTH),
+            shading_mode(FLAT_SHADING),
+            near_plane(1.f),
+            z_buffer(target.get_width()* target.get_height()),
+            z_blocks_x((int(target.get_width()) + z_block_size - 1) / z_block_size),
+            z_blocks_y((int(target.get_height()) + z_block_size - 1) / z_block_size),
+            hierarchical_z(true)
         {
+            z_block_max.resize(size_t(z_blocks_x) * z_blocks_y, std::numeric_limits< int >::max());
+            z_block_dirty.resize(size_t(z_blocks_x) * z_blocks_y, 0);
         }
 
         const Color_Buffer& get_color_buffer() const
@@ -61,6 +216,116 @@ namespace MGVisualizer
             color = new_color;
         }
 
+        const Color& get_color() const
+        {
+            return (color);
+        }
+
+        void set_span_kernel(SpanFiller::Kernels kernel)
+        {
+            span_filler = SpanFiller::get_function(kernel);
+            reversed_span_filler = SpanFiller::get_reversed_function(kernel);
+        }
+
+        // Cambia la rutina de relleno. Con HALF_SPACE_FILL las coordenadas X e Y de los vrtices
+        // deben venir multiplicadas por 1 << subpixel_bits:
+
+        void set_fill_mode(Fill_Modes mode)
+        {
+            fill_mode = mode;
+        }
+
+        Fill_Modes get_fill_mode() const
+        {
+            return (fill_mode);
+        }
+
+        int get_subpixel_bits() const
+        {
+            return (fill_mode == HALF_SPACE_FILL ? subpixel_bits : 0);
+        }
+
+        // Cambia el formato de la profundidad. Las Z de los vrtices deben obtenerse despus con
+        // get_depth_key():
+
+        void set_depth_format(Depth_Formats format)
+        {
+            depth_format = format;
+        }
+
+        Depth_Formats get_depth_format() const
+        {
+            return (depth_format);
+        }
+
+        // Distancia de la cmara al plano near, que FLOAT_REVERSED_DEPTH hace corresponder con 1:
+
+        void set_near_plane(float distance)
+        {
+            near_plane = distance;
+        }
+
+        // Con GOURAUD_SHADING los polgonos que se rellenan con colores por vrtice los interpolan.
+        // Los que solo tienen un color se siguen rellenando planos:
+
+        void set_shading_mode(Shading_Modes mode)
+        {
+            shading_mode = mode;
+        }
+
+        Shading_Modes get_shading_mode() const
+        {
+            return (shading_mode);
+        }
+
+        // Valor del z-buffer para un vrtice con las coordenadas de recorte z y w dadas, que debe
+        // estar entre los planos near y far. La Z normalizada es afn en 1 / w, as que interpolarla
+        // linealmente en pantalla ya corrige la perspectiva:
+
+        int get_depth_key(float z, float w) const
+        {
+            if (depth_format == FLOAT_REVERSED_DEPTH)
+            {
+                // Z invertida de una proyeccin con el plano far en el infinito. Sale de w sin restas,
+                // as que el float no pierde bits lejos de la cmara como al obtenerla de la Z de recorte,
+                // cuyo error ya es del orden de la diferencia entre z y w:
+
+                float depth = near_plane / w;
+
+                return SpanFiller::get_reversed_depth_key(std::min(std::max(depth, 0.f), 1.f));
+            }
+
+            float depth = std::min(std::max(0.5f * z / w + 0.5f, 0.f), 1.f);
+
+            return int(std::lround(depth * float((1 << fixed_depth_bits) - 1))) << fixed_depth_fraction_bits;
+        }
+
+        // Permite desactivar el descarte con el z-buffer jerrquico para comparar:
+
+        void set_hierarchical_z(bool enabled)
+        {
+            hierarchical_z = enabled;
+        }
+
+        // Suma a los contadores dados lo descartado por el z-buffer jerrquico desde la ltima
+        // llamada y los pone a cero:
+
+        void take_occlusion_stats(unsigned& polygons, uint64_t& pixels)
+        {
+            polygons += edge_cache.occluded_polygons;
+            pixels   += edge_cache.occluded_pixels;
+
+            edge_cache.occluded_polygons = 0;
+            edge_cache.occluded_pixels = 0;
+        }
+
+        // Scanlines fuera del color buffer que pueden ocupar los polgonos:
+
+        void set_guard_margin(unsigned lines)
+        {
+            edge_cache.resize(color_buffer.get_height(), lines);
+        }
+
         void set_color(float r, float g, float b)
         {
             color_buffer.set(r, g, b);
@@ -75,8 +340,17 @@ namespace MGVisualizer
             {
                 *z = std::numeric_limits< int >::max();
             }
+
+            std::fill(z_block_max.begin(), z_block_max.end(), std::numeric_limits< int >::max());
+            std::fill(z_block_dirty.begin(), z_block_dirty.end(), 0);
         }
 
+        // Comprueba si algo que no est ms cerca que z dentro del rectngulo dado queda oculto
+        // por lo que ya hay en el z-buffer. Solo consulta los bloques que tocan el rectngulo,
+        // as que hilos con rectngulos alineados a bloques distintos pueden llamarla a la vez:
+
+        bool is_occluded(const Scissor& area, int z);
+
         void fill_convex_polygon
         (
             const ivec4* const vertices,
@@ -91,18 +365,121 @@ namespace MGVisualizer
             const int* const indices_end
         );
 
+        void fill_convex_polygon_z_buffer
+        (
+            const ivec4* const vertices,
+            const Color* const vertex_colors,
+            const int* const indices_begin,
+            const int* const indices_end
+        );
+
+        // vertex_colors puede ser nulo para rellenar el polgono con polygon_color:
+
+        void fill_convex_polygon_z_buffer
+        (
+            const ivec4* const vertices,
+            const int* const indices_begin,
+            const int* const indices_end,
+            const Color& polygon_color,
+            Edge_Cache& cache,
+            const Scissor& scissor,
+            const Color* const vertex_colors = nullptr
+        );
+
     private:
 
+        template< class SHADING >
+        void fill_convex_polygon_scanline
+        (
+            const ivec4* const vertices,
+            const int* const indices_begin,
+            const int* const indices_end,
+            const Color& polygon_color,
+            const Color* const vertex_colors,
+            Edge_Cache& cache,
+            const Scissor& scissor
+        );
+
+        template< bool REVERSED_DEPTH >
+        void fill_span_gouraud
+        (
+            int offset,
+            int count,
+            int64_t z,
+            int64_t z_step,
+            float depth,
+            float depth_step,
+            const int* color,
+            const int* color_step
+        );
+
+        // Componentes de un color en punto fijo 8.16, con medio paso sumado para redondear:
+
+        static void get_color_components(const Color& color, int* components)
+        {
+            components[0] = (int(color.red  ()) << 16) + 0x8000;
+            components[1] = (int(color.green()) << 16) + 0x8000;
+            components[2] = (int(color.blue ()) << 16) + 0x8000;
+        }
+
+        static Color make_color(const int* components)
+        {
+            Color color;
+
+            color.red  () = typename std::remove_reference< decltype(color.red()) >::type(components[0] >> 16);
+            color.green() = typename std::remove_reference< decltype(color.green()) >::type(components[1] >> 16);
+            color.blue () = typename std::remove_reference< decltype(color.blue()) >::type(components[2] >> 16);
+
+            return color;
+        }
+
         template< typename VALUE_TYPE, size_t SHIFT >
         void interpolate(int* cache, int v0, int v1, int y_min, int y_max);
 
-    };
+        void interpolate_depth(float* cache, int z0, int z1, int y_min, int y_max);
+
+        void interpolate_colors(int** caches, const Color& color0, const Color& color1, int y_min, int y_max);
 
-    template< class COLOR_BUFFER_TYPE > int Rasterizer< COLOR_BUFFER_TYPE >::offset_cache0[2160];
-    template< class COLOR_BUFFER_TYPE > int Rasterizer< COLOR_BUFFER_TYPE >::offset_cache1[2160];
+        void fill_span_reversed(int offset, int count, float depth, float depth_step, const Color& polygon_color);
 
-    template< class COLOR_BUFFER_TYPE > int Rasterizer< COLOR_BUFFER_TYPE >::z_cache0[2160];
-    template< class COLOR_BUFFER_TYPE > int Rasterizer< COLOR_BUFFER_TYPE >::z_cache1[2160];
+        void update_z_block(int block_x, int block_y);
+
+        void fill_convex_polygon_half_space
+        (
+            const ivec4* const vertices,
+            const int* const indices_begin,
+            const int* const indices_end,
+            const Color& polygon_color,
+            const Color* const vertex_colors,
+            Edge_Cache& cache,
+            const Scissor& scissor
+        );
+
+        template< bool REVERSED_DEPTH, class SHADING >
+        void fill_triangle_half_space
+        (
+            const ivec4& v0,
+            const ivec4& v1,
+            const ivec4& v2,
+            const Color* const colors[3],
+            const Color& polygon_color,
+            const Scissor& area
+        );
+
+        void count_occluded
+        (
+            const ivec4* const vertices,
+            const int* const indices_begin,
+            const int* const indices_end,
+            int shift,
+            double bounds_area,
+            const Scissor& area,
+            Edge_Cache& cache
+        );
+
+        void mark_z_blocks(const Scissor& area);
+
+    };
 
     template< class  COLOR_BUFFER_TYPE >
     void Rasterizer< COLOR_BUFFER_TYPE >::fill_convex_polygon
@@ -115,8 +492,8 @@ namespace MGVisualizer
         // Se cachean algunos valores de inters:
 
         int   pitch = color_buffer.get_width();
-        int* offset_cache0 = this->offset_cache0;
-        int* offset_cache1 = this->offset_cache1;
+        int* offset_cache0 = edge_cache.offset0.data() + edge_cache.origin;
+        int* offset_cache1 = edge_cache.offset1.data() + edge_cache.origin;
         const int* indices_back = indices_end - 1;
 
         // Se busca el vrtice de inicio (el que tiene menor Y) y el de terminacin (el que tiene mayor Y):
@@ -229,16 +606,120 @@ namespace MGVisualizer
         const int* const indices_begin,
         const int* const indices_end
     )
+    {
+        Scissor scissor = { 0, 0, int(color_buffer.get_width()), int(color_buffer.get_height()) };
+
+        fill_convex_polygon_z_buffer(vertices, indices_begin, indices_end, color, edge_cache, scissor);
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    void Rasterizer< COLOR_BUFFER_TYPE >::fill_convex_polygon_z_buffer
+    (
+        const ivec4* const vertices,
+        const Color* const vertex_colors,
+        const int* const indices_begin,
+        const int* const indices_end
+    )
+    {
+        Scissor scissor = { 0, 0, int(color_buffer.get_width()), int(color_buffer.get_height()) };
+
+        fill_convex_polygon_z_buffer(vertices, indices_begin, indices_end, color, edge_cache, scissor, vertex_colors);
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    void Rasterizer< COLOR_BUFFER_TYPE >::fill_convex_polygon_z_buffer
+    (
+        const ivec4* const vertices,
+        const int* const indices_begin,
+        const int* const indices_end,
+        const Color& polygon_color,
+        Edge_Cache& cache,
+        const Scissor& scissor,
+        const Color* const vertex_colors
+    )
+    {
+        // Los colores por vrtice solo se usan con sombreado Gouraud:
+
+        const Color* colors = shading_mode == GOURAUD_SHADING ? vertex_colors : nullptr;
+
+        if (fill_mode == HALF_SPACE_FILL)
+            fill_convex_polygon_half_space(vertices, indices_begin, indices_end, polygon_color, colors, cache, scissor);
+        else
+        if (colors != nullptr)
+            fill_convex_polygon_scanline< Gouraud_Shading >(vertices, indices_begin, indices_end, polygon_color, colors, cache, scissor);
+        else
+            fill_convex_polygon_scanline< Flat_Shading    >(vertices, indices_begin, indices_end, polygon_color, colors, cache, scissor);
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    template< class  SHADING >
+    void Rasterizer< COLOR_BUFFER_TYPE >::fill_convex_polygon_scanline
+    (
+        const ivec4* const vertices,
+        const int* const indices_begin,
+        const int* const indices_end,
+        const Color& polygon_color,
+        const Color* const vertex_colors,
+        Edge_Cache& cache,
+        const Scissor& scissor
+    )
     {
         // Se cachean algunos valores de inters:
 
         int   pitch = color_buffer.get_width();
-        int* offset_cache0 = this->offset_cache0;
-        int* offset_cache1 = this->offset_cache1;
-        int* z_cache0 = this->z_cache0;
-        int* z_cache1 = this->z_cache1;
+        int* offset_cache0 = cache.offset0.data() + cache.origin;
+        int* offset_cache1 = cache.offset1.data() + cache.origin;
+        int* z_cache0 = cache.z0.data() + cache.origin;
+        int* z_cache1 = cache.z1.data() + cache.origin;
+        float* depth_cache0 = cache.depth0.data() + cache.origin;
+        float* depth_cache1 = cache.depth1.data() + cache.origin;
+        bool reversed_depth = depth_format == FLOAT_REVERSED_DEPTH;
+
+        int* color_cache0[3];
+        int* color_cache1[3];
+
+        for (int component = 0; component < 3; component++)
+        {
+            color_cache0[component] = cache.color0[component].data() + cache.origin;
+            color_cache1[component] = cache.color1[component].data() + cache.origin;
+        }
+
+        int* z_buffer = this->z_buffer.data();
         const int* indices_back = indices_end - 1;
 
+        // Se calcula el rectngulo que cubre el polgono dentro del scissor y su Z ms cercana.
+        // Ningn pxel del polgono tiene una Z menor, as que si todos los bloques que toca
+        // ya tienen algo ms cerca se descarta sin recorrer ninguna scanline:
+
+        int min_x = vertices[*indices_begin][0], max_x = min_x;
+        int min_y = vertices[*indices_begin][1], max_y = min_y;
+        int min_z = vertices[*indices_begin][2];
+
+        for (const int* index_iterator = indices_begin; ++index_iterator < indices_end; )
+        {
+            const ivec4& vertex = vertices[*index_iterator];
+
+            min_x = std::min(min_x, vertex[0]); max_x = std::max(max_x, vertex[0]);
+            min_y = std::min(min_y, vertex[1]); max_y = std::max(max_y, vertex[1]);
+            min_z = std::min(min_z, vertex[2]);
+        }
+
+        Scissor area;
+        area.x0 = std::max(min_x, scissor.x0);
+        area.y0 = std::max(min_y, scissor.y0);
+        area.x1 = std::min(max_x + 1, scissor.x1);
+        area.y1 = std::min(max_y, scissor.y1);
+
+        if (area.x0 >= area.x1 || area.y0 >= area.y1) return;
+
+        if (is_occluded(area, min_z))
+        {
+            count_occluded(vertices, indices_begin, indices_end, 0, double(max_x - min_x + 1) * double(max_y - min_y), area, cache);
+            return;
+        }
+
+        mark_z_blocks(area);
+
         // Se busca el vrtice de inicio (el que tiene menor Y) y el de terminacin (el que tiene mayor Y):
 
         const int* start_index = indices_begin;
@@ -279,7 +760,16 @@ namespace MGVisualizer
         while (true)
         {
             interpolate< int64_t, 32 >(offset_cache0, o0, o1, y0, y1);
-            interpolate< int32_t, 0 >(z_cache0, z0, z1, y0, y1);
+
+            if (reversed_depth)
+                interpolate_depth(depth_cache0, z0, z1, y0, y1);
+            else
+                interpolate< int64_t, 32 >(z_cache0, z0, z1, y0, y1);
+
+            if constexpr (SHADING::interpolates_colors)
+            {
+                interpolate_colors(color_cache0, vertex_colors[*current_index], vertex_colors[*next_index], y0, y1);
+            }
 
             if (current_index == indices_begin) current_index = indices_back; else current_index--;
             if (current_index == end_index) break;
@@ -311,7 +801,16 @@ namespace MGVisualizer
         while (true)
         {
             interpolate< int64_t, 32 >(offset_cache1, o0, o1, y0, y1);
-            interpolate< int32_t, 0 >(z_cache1, z0, z1, y0, y1);
+
+            if (reversed_depth)
+                interpolate_depth(depth_cache1, z0, z1, y0, y1);
+            else
+                interpolate< int64_t, 32 >(z_cache1, z0, z1, y0, y1);
+
+            if constexpr (SHADING::interpolates_colors)
+            {
+                interpolate_colors(color_cache1, vertex_colors[*current_index], vertex_colors[*next_index], y0, y1);
+            }
 
             if (current_index == indices_back) current_index = indices_begin; else current_index++;
             if (current_index == end_index) break;
@@ -333,6 +832,8 @@ namespace MGVisualizer
         offset_cache1 += start_y;
         z_cache0 += start_y;
         z_cache1 += start_y;
+        depth_cache0 += start_y;
+        depth_cache1 += start_y;
 
         for (int y = start_y; y < end_y; y++)
         {
@@ -341,43 +842,586 @@ namespace MGVisualizer
             z0 = *z_cache0++;
             z1 = *z_cache1++;
 
+            float d0 = *depth_cache0++;
+            float d1 = *depth_cache1++;
+
+            // Por debajo del scissor ya no queda nada que rellenar:
+
+            if (y >= scissor.y1) break;
+
+            // El span empieza en el extremo con menor offset:
+
+            int left, right, z, z_delta;
+            float depth, depth_delta;
+
             if (o0 < o1)
             {
-                int z_step = (z1 - z0) / (o1 - o0);
+                left = o0; right = o1; z = z0; z_delta = z1 - z0; depth = d0; depth_delta = d1 - d0;
+            }
+            else
+                if (o1 < o0)
+                {
+                    left = o1; right = o0; z = z1; z_delta = z0 - z1; depth = d1; depth_delta = d0 - d1;
+                }
+                else
+                    continue;
+
+            if (y >= scissor.y0)
+            {
+                // Se recorta el span contra el scissor conservando la Z que tendra sin recortar:
 
-                while (o0 < o1)
+                int row = y * pitch;
+                int begin = std::max(left, row + scissor.x0);
+                int end = std::min(right, row + scissor.x1);
+
+                if (begin < end)
                 {
-                    if (z0 < z_buffer[o0])
+                    // La Z avanza en punto fijo 32.32 para que el paso no pierda su parte fraccionaria.
+                    // En float invertido se interpola la profundidad como float:
+
+                    int64_t z_step = 0, z_span = 0;
+                    float   depth_step = 0.f;
+
+                    if (reversed_depth)
                     {
-                        color_buffer.set_pixel(o0, color);
-                        z_buffer[o0] = z0;
+                        depth_step = depth_delta / float(right - left);
+                        depth += float(begin - left) * depth_step;
                     }
+                    else
+                    {
+                        z_step = (int64_t(z_delta) << 32) / (right - left);
+                        z_span = (int64_t(z) << 32) + z_step * (begin - left);
+                    }
+
+                    if constexpr (SHADING::interpolates_colors)
+                    {
+                        // Los colores avanzan en 8.16 desde el extremo izquierdo:
 
-                    z0 += z_step;
-                    o0++;
+                        int color[3], color_step[3];
+
+                        for (int component = 0; component < 3; component++)
+                        {
+                            int c0 = color_cache0[component][y];
+                            int c1 = color_cache1[component][y];
+
+                            int left_color = o0 < o1 ? c0 : c1;
+                            int delta = o0 < o1 ? c1 - c0 : c0 - c1;
+
+                            color_step[component] = delta / (right - left);
+                            color[component] = left_color + color_step[component] * (begin - left);
+                        }
+
+                        if (reversed_depth)
+                            fill_span_gouraud< true  >(begin, end - begin, z_span, z_step, depth, depth_step, color, color_step);
+                        else
+                            fill_span_gouraud< false >(begin, end - begin, z_span, z_step, depth, depth_step, color, color_step);
+                    }
+                    else
+                    if (reversed_depth)
+                    {
+                        fill_span_reversed(begin, end - begin, depth, depth_step, polygon_color);
+                    }
+                    else
+                    if constexpr (std::is_same< Color, Rgb888 >::value)
+                    {
+                        span_filler(z_buffer + begin, color_buffer.pixels() + begin, end - begin, z_span, z_step, polygon_color);
+                    }
+                    else
+                    {
+                        for (int offset = begin; offset < end; offset++)
+                        {
+                            int key = int(z_span >> 32);
+
+                            if (key < z_buffer[offset])
+                            {
+                                color_buffer.set_pixel(offset, polygon_color);
+                                z_buffer[offset] = key;
+                            }
+
+                            z_span += z_step;
+                        }
+                    }
                 }
+            }
 
-                if (o0 > end_offset) break;
+            if (right > end_offset) break;
+        }
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    void Rasterizer< COLOR_BUFFER_TYPE >::count_occluded
+    (
+        const ivec4* const vertices,
+        const int* const indices_begin,
+        const int* const indices_end,
+        int shift,
+        double bounds_area,
+        const Scissor& area,
+        Edge_Cache& cache
+    )
+    {
+        // Se estima lo que habra cubierto dentro del scissor a partir de su rea:
+
+        double polygon_area = 0.0;
+
+        for (const int* index_iterator = indices_begin; index_iterator < indices_end; index_iterator++)
+        {
+            const ivec4& v0 = vertices[*index_iterator];
+            const ivec4& v1 = vertices[index_iterator + 1 < indices_end ? index_iterator[1] : *indices_begin];
+
+            polygon_area += double(v0[0]) * v1[1] - double(v1[0]) * v0[1];
+        }
+
+        polygon_area /= double(int64_t(1) << (2 * shift));
+
+        double inside_area = double(area.x1 - area.x0) * double(area.y1 - area.y0);
+
+        cache.occluded_polygons++;
+        cache.occluded_pixels += uint64_t(std::abs(polygon_area) * 0.5 * inside_area / bounds_area);
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    void Rasterizer< COLOR_BUFFER_TYPE >::fill_convex_polygon_half_space
+    (
+        const ivec4* const vertices,
+        const int* const indices_begin,
+        const int* const indices_end,
+        const Color& polygon_color,
+        const Color* const vertex_colors,
+        Edge_Cache& cache,
+        const Scissor& scissor
+    )
+    {
+        // Los centros de los pxeles estn en (x + 0.5, y + 0.5). Se calculan las filas y columnas
+        // de los centros que pueden quedar dentro del polgono, recortadas al scissor:
+
+        const int half = 1 << (subpixel_bits - 1);
+
+        int min_x = vertices[*indices_begin][0], max_x = min_x;
+        int min_y = vertices[*indices_begin][1], max_y = min_y;
+        int min_z = vertices[*indices_begin][2];
+
+        for (const int* index_iterator = indices_begin; ++index_iterator < indices_end; )
+        {
+            const ivec4& vertex = vertices[*index_iterator];
+
+            min_x = std::min(min_x, vertex[0]); max_x = std::max(max_x, vertex[0]);
+            min_y = std::min(min_y, vertex[1]); max_y = std::max(max_y, vertex[1]);
+            min_z = std::min(min_z, vertex[2]);
+        }
+
+        int first_x = (min_x - half + (1 << subpixel_bits) - 1) >> subpixel_bits;
+        int first_y = (min_y - half + (1 << subpixel_bits) - 1) >> subpixel_bits;
+        int last_x  = (max_x - half) >> subpixel_bits;
+        int last_y  = (max_y - half) >> subpixel_bits;
+
+        Scissor area;
+        area.x0 = std::max(first_x, scissor.x0);
+        area.y0 = std::max(first_y, scissor.y0);
+        area.x1 = std::min(last_x + 1, scissor.x1);
+        area.y1 = std::min(last_y + 1, scissor.y1);
+
+        if (area.x0 >= area.x1 || area.y0 >= area.y1) return;
+
+        if (is_occluded(area, min_z))
+        {
+            count_occluded(vertices, indices_begin, indices_end, subpixel_bits, double(last_x - first_x + 1) * double(last_y - first_y + 1), area, cache);
+            return;
+        }
+
+        // Se rellena en abanico. La regla top-left evita que las aristas interiores se pinten dos veces:
+
+        const ivec4& v0 = vertices[*indices_begin];
+
+        bool reversed_depth = depth_format == FLOAT_REVERSED_DEPTH;
+
+        for (const int* index_iterator = indices_begin + 1; index_iterator + 1 < indices_end; index_iterator++)
+        {
+            const ivec4& v1 = vertices[index_iterator[0]];
+            const ivec4& v2 = vertices[index_iterator[1]];
+
+            if (vertex_colors != nullptr)
+            {
+                const Color* colors[3] = { &vertex_colors[*indices_begin], &vertex_colors[index_iterator[0]], &vertex_colors[index_iterator[1]] };
+
+                if (reversed_depth)
+                    fill_triangle_half_space< true,  Gouraud_Shading >(v0, v1, v2, colors, polygon_color, area);
+                else
+                    fill_triangle_half_space< false, Gouraud_Shading >(v0, v1, v2, colors, polygon_color, area);
             }
             else
-                if (o1 < o0)
+            {
+                const Color* colors[3] = { nullptr, nullptr, nullptr };
+
+                if (reversed_depth)
+                    fill_triangle_half_space< true,  Flat_Shading >(v0, v1, v2, colors, polygon_color, area);
+                else
+                    fill_triangle_half_space< false, Flat_Shading >(v0, v1, v2, colors, polygon_color, area);
+            }
+        }
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    template< bool REVERSED_DEPTH, class SHADING >
+    void Rasterizer< COLOR_BUFFER_TYPE >::fill_triangle_half_space
+    (
+        const ivec4& v0,
+        const ivec4& v1,
+        const ivec4& v2,
+        const Color* const colors[3],
+        const Color& polygon_color,
+        const Scissor& area
+    )
+    {
+        // Se trabaja con 64 bits porque los productos de coordenadas 24.8 no caben en 32:
+
+        int64_t x0 = v0[0], y0 = v0[1], z0 = v0[2];
+        int64_t x1 = v1[0], y1 = v1[1], z1 = v1[2];
+        int64_t x2 = v2[0], y2 = v2[1], z2 = v2[2];
+
+        int64_t twice_area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+
+        if (twice_area == 0) return;
+
+        const Color* color0 = colors[0];
+        const Color* color1 = colors[1];
+        const Color* color2 = colors[2];
+
+        // Se ordenan los vrtices para que el interior quede a la izquierda de las tres aristas:
+
+        if (twice_area < 0)
+        {
+            std::swap(x1, x2); std::swap(y1, y2); std::swap(z1, z2);
+            std::swap(color1, color2);
+            twice_area = -twice_area;
+        }
+
+        // Funciones de arista E(x, y) = a * x + b * y + c, positivas en el interior. Las aristas que
+        // no son superiores ni izquierdas restan uno para que los pxeles sobre ellas no se pinten:
+
+        const int64_t xs[3] = { x1, x2, x0 }, ys[3] = { y1, y2, y0 };
+        const int64_t xe[3] = { x2, x0, x1 }, ye[3] = { y2, y0, y1 };
+
+        int64_t a[3], b[3], c[3];
+
+        for (int edge = 0; edge < 3; edge++)
+        {
+            int64_t dx = xe[edge] - xs[edge];
+            int64_t dy = ye[edge] - ys[edge];
+
+            bool top_left = dy < 0 || (dy == 0 && dx > 0);
+
+            a[edge] = -dy;
+            b[edge] =  dx;
+            c[edge] = dy * xs[edge] - dx * ys[edge] - (top_left ? 0 : 1);
+        }
+
+        // Gradientes de la profundidad por pxel a partir de las coordenadas baricntricas. En punto
+        // fijo se avanza en 16.16, en float invertido se interpola el float y se convierte en cada pxel:
+
+        const int     one_pixel = 1 << subpixel_bits;
+        const int     half = one_pixel >> 1;
+        const double  inverse_area = 1.0 / double(twice_area);
+
+        double depth0 = REVERSED_DEPTH ? double(SpanFiller::get_reversed_depth(int(z0))) : double(z0);
+        double depth1 = REVERSED_DEPTH ? double(SpanFiller::get_reversed_depth(int(z1))) : double(z1);
+        double depth2 = REVERSED_DEPTH ? double(SpanFiller::get_reversed_depth(int(z2))) : double(z2);
+
+        const double  dz1 = depth1 - depth0, dz2 = depth2 - depth0;
+
+        double z_dx = (double(a[1]) * dz1 + double(a[2]) * dz2) * inverse_area * one_pixel;
+        double z_dy = (double(b[1]) * dz1 + double(b[2]) * dz2) * inverse_area * one_pixel;
+
+        int64_t z_step_x = int64_t(std::llround(z_dx * 65536.0));
+
+        // Con sombreado Gouraud cada componente del color es otro plano como la Z:
+
+        double color_base[3] = { }, color_dx[3] = { }, color_dy[3] = { };
+
+        if constexpr (SHADING::interpolates_colors)
+        {
+            int components0[3], components1[3], components2[3];
+
+            get_color_components(*color0, components0);
+            get_color_components(*color1, components1);
+            get_color_components(*color2, components2);
+
+            for (int component = 0; component < 3; component++)
+            {
+                double dc1 = double(components1[component] - components0[component]);
+                double dc2 = double(components2[component] - components0[component]);
+
+                color_base[component] = double(components0[component]);
+                color_dx  [component] = (double(a[1]) * dc1 + double(a[2]) * dc2) * inverse_area * one_pixel;
+                color_dy  [component] = (double(b[1]) * dc1 + double(b[2]) * dc2) * inverse_area * one_pixel;
+            }
+        }
+
+        int min_z = int(std::min(z0, std::min(z1, z2)));
+
+        int  pitch = color_buffer.get_width();
+        int* z_buffer = this->z_buffer.data();
+
+        // Se recorren los bloques de 8x8 que toca el rectngulo:
+
+        for (int block_y = area.y0 & ~(z_block_size - 1); block_y < area.y1; block_y += z_block_size)
+        {
+            for (int block_x = area.x0 & ~(z_block_size - 1); block_x < area.x1; block_x += z_block_size)
+            {
+                // Valores de las funciones de arista en los centros de las esquinas del bloque. Al
+                // ser lineales, si las cuatro son negativas en una arista el bloque queda fuera y
+                // si son positivas en todas el bloque queda entero dentro:
+
+                int64_t center_x = (int64_t(block_x) << subpixel_bits) + half;
+                int64_t center_y = (int64_t(block_y) << subpixel_bits) + half;
+
+                int64_t origin[3];
+                bool    outside = false;
+                bool    inside  = true;
+
+                for (int edge = 0; edge < 3; edge++)
                 {
-                    int z_step = (z0 - z1) / (o0 - o1);
+                    int64_t e00 = a[edge] * center_x + b[edge] * center_y + c[edge];
+                    int64_t e10 = e00 + a[edge] * (z_block_size - 1) * one_pixel;
+                    int64_t e01 = e00 + b[edge] * (z_block_size - 1) * one_pixel;
+                    int64_t e11 = e10 + b[edge] * (z_block_size - 1) * one_pixel;
+
+                    if ((e00 & e10 & e01 & e11) < 0) outside = true;
+                    if ((e00 | e10 | e01 | e11) < 0) inside = false;
 
-                    while (o1 < o0)
+                    origin[edge] = e00;
+                }
+
+                if (outside) continue;
+
+                int block = (block_y / z_block_size) * z_blocks_x + block_x / z_block_size;
+
+                // Bloque tapado por lo que ya hay en el z-buffer:
+
+                if (hierarchical_z)
+                {
+                    if (z_block_dirty[block]) update_z_block(block_x / z_block_size, block_y / z_block_size);
+
+                    if (min_z >= z_block_max[block]) continue;
+                }
+
+                int x_begin = std::max(block_x, area.x0), x_end = std::min(block_x + z_block_size, area.x1);
+                int y_begin = std::max(block_y, area.y0), y_end = std::min(block_y + z_block_size, area.y1);
+
+                bool written = false;
+
+                for (int y = y_begin; y < y_end; y++)
+                {
+                    int64_t rows = int64_t(y - block_y) * one_pixel;
+                    int64_t columns = int64_t(x_begin - block_x) * one_pixel;
+
+                    int64_t e0 = origin[0] + b[0] * rows + a[0] * columns;
+                    int64_t e1 = origin[1] + b[1] * rows + a[1] * columns;
+                    int64_t e2 = origin[2] + b[2] * rows + a[2] * columns;
+
+                    double pixel_x = double((int64_t(x_begin) << subpixel_bits) + half - x0) / one_pixel;
+                    double pixel_y = double((int64_t(y) << subpixel_bits) + half - y0) / one_pixel;
+
+                    double  depth = depth0 + z_dx * pixel_x + z_dy * pixel_y;
+                    int64_t z = int64_t(std::llround(depth * 65536.0));
+
+                    double  color[3];
+
+                    for (int component = 0; component < 3; component++)
+                        color[component] = color_base[component] + color_dx[component] * pixel_x + color_dy[component] * pixel_y;
+
+                    int offset = y * pitch + x_begin;
+
+                    for (int x = x_begin; x < x_end; x++, offset++)
                     {
-                        if (z1 < z_buffer[o1])
+                        if (inside || (e0 | e1 | e2) >= 0)
                         {
-                            color_buffer.set_pixel(o1, color);
-                            z_buffer[o1] = z1;
+                            int key;
+
+                            if constexpr (REVERSED_DEPTH)
+                                key = SpanFiller::get_reversed_depth_key(std::max(float(depth), 0.f));
+                            else
+                                key = int(z >> 16);
+
+                            if (key < z_buffer[offset])
+                            {
+                                if constexpr (SHADING::interpolates_colors)
+                                {
+                                    // Se limita a los 8 bits por si el redondeo se sale del tringulo:
+
+                                    int components[3];
+
+                                    for (int component = 0; component < 3; component++)
+                                        components[component] = std::min(std::max(int(color[component]), 0), (255 << 16) | 0xFFFF);
+
+                                    color_buffer.set_pixel(offset, make_color(components));
+                                }
+                                else
+                                    color_buffer.set_pixel(offset, polygon_color);
+
+                                z_buffer[offset] = key;
+                                written = true;
+                            }
                         }
 
-                        z1 += z_step;
-                        o1++;
+                        e0 += a[0] * one_pixel;
+                        e1 += a[1] * one_pixel;
+                        e2 += a[2] * one_pixel;
+                        z  += z_step_x;
+                        depth += z_dx;
+
+                        if constexpr (SHADING::interpolates_colors)
+                        {
+                            for (int component = 0; component < 3; component++)
+                                color[component] += color_dx[component];
+                        }
                     }
+                }
 
-                    if (o1 > end_offset) break;
+                if (written) z_block_dirty[block] = 1;
+            }
+        }
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    template< bool REVERSED_DEPTH >
+    void Rasterizer< COLOR_BUFFER_TYPE >::fill_span_gouraud
+    (
+        int offset,
+        int count,
+        int64_t z,
+        int64_t z_step,
+        float depth,
+        float depth_step,
+        const int* color,
+        const int* color_step
+    )
+    {
+        int* z_buffer = this->z_buffer.data() + offset;
+
+        int components[3] = { color[0], color[1], color[2] };
+
+        for (int i = 0; i < count; i++)
+        {
+            int key;
+
+            if constexpr (REVERSED_DEPTH)
+                key = SpanFiller::get_reversed_depth_key(std::max(depth + float(i) * depth_step, 0.f));
+            else
+                key = int(z >> 32);
+
+            if (key < z_buffer[i])
+            {
+                color_buffer.set_pixel(offset + i, make_color(components));
+                z_buffer[i] = key;
+            }
+
+            z += z_step;
+
+            components[0] += color_step[0];
+            components[1] += color_step[1];
+            components[2] += color_step[2];
+        }
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    void Rasterizer< COLOR_BUFFER_TYPE >::fill_span_reversed(int offset, int count, float depth, float depth_step, const Color& polygon_color)
+    {
+        int* z_buffer = this->z_buffer.data() + offset;
+
+        if constexpr (std::is_same< Color, Rgb888 >::value)
+        {
+            reversed_span_filler(z_buffer, color_buffer.pixels() + offset, count, depth, depth_step, polygon_color);
+        }
+        else
+        {
+            for (int i = 0; i < count; i++)
+            {
+                int z = SpanFiller::get_reversed_depth_key(std::max(depth + float(i) * depth_step, 0.f));
+
+                if (z < z_buffer[i])
+                {
+                    color_buffer.set_pixel(offset + i, polygon_color);
+                    z_buffer[i] = z;
                 }
+            }
+        }
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    bool Rasterizer< COLOR_BUFFER_TYPE >::is_occluded(const Scissor& area, int z)
+    {
+        if (not hierarchical_z) return false;
+
+        int x0 = std::max(area.x0, 0);
+        int y0 = std::max(area.y0, 0);
+        int x1 = std::min(area.x1, int(color_buffer.get_width()));
+        int y1 = std::min(area.y1, int(color_buffer.get_height()));
+
+        if (x0 >= x1 || y0 >= y1) return false;
+
+        for (int block_y = y0 / z_block_size, last_y = (y1 - 1) / z_block_size; block_y <= last_y; block_y++)
+        {
+            for (int block_x = x0 / z_block_size, last_x = (x1 - 1) / z_block_size; block_x <= last_x; block_x++)
+            {
+                int block = block_y * z_blocks_x + block_x;
+
+                if (z_block_dirty[block]) update_z_block(block_x, block_y);
+
+                // El test de profundidad es z < z_buffer:
+
+                if (z < z_block_max[block]) return false;
+            }
+        }
+
+        return true;
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    void Rasterizer< COLOR_BUFFER_TYPE >::update_z_block(int block_x, int block_y)
+    {
+        int pitch = color_buffer.get_width();
+        int x0 = block_x * z_block_size;
+        int y0 = block_y * z_block_size;
+        int x1 = std::min(x0 + z_block_size, pitch);
+        int y1 = std::min(y0 + z_block_size, int(color_buffer.get_height()));
+
+        int z_max = std::numeric_limits< int >::min();
+
+        for (int y = y0; y < y1; y++)
+        {
+            const int* row = z_buffer.data() + y * pitch;
+
+            for (int x = x0; x < x1; x++)
+            {
+                z_max = std::max(z_max, row[x]);
+            }
+        }
+
+        int block = block_y * z_blocks_x + block_x;
+
+        z_block_max[block] = z_max;
+        z_block_dirty[block] = 0;
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    void Rasterizer< COLOR_BUFFER_TYPE >::mark_z_blocks(const Scissor& area)
+    {
+        int x0 = std::max(area.x0, 0);
+        int y0 = std::max(area.y0, 0);
+        int x1 = std::min(area.x1, int(color_buffer.get_width()));
+        int y1 = std::min(area.y1, int(color_buffer.get_height()));
+
+        if (x0 >= x1 || y0 >= y1) return;
+
+        for (int block_y = y0 / z_block_size, last_y = (y1 - 1) / z_block_size; block_y <= last_y; block_y++)
+        {
+            uint8_t* dirty = z_block_dirty.data() + block_y * z_blocks_x;
+
+            for (int block_x = x0 / z_block_size, last_x = (x1 - 1) / z_block_size; block_x <= last_x; block_x++)
+            {
+                dirty[block_x] = 1;
+            }
         }
     }
 
@@ -400,6 +1444,37 @@ namespace MGVisualizer
         }
     }
 
+    template< class  COLOR_BUFFER_TYPE >
+    void Rasterizer< COLOR_BUFFER_TYPE >::interpolate_colors(int** caches, const Color& color0, const Color& color1, int y_min, int y_max)
+    {
+        int components0[3], components1[3];
+
+        get_color_components(color0, components0);
+        get_color_components(color1, components1);
+
+        for (int component = 0; component < 3; component++)
+        {
+            interpolate< int64_t, 32 >(caches[component], components0[component], components1[component], y_min, y_max);
+        }
+    }
+
+    template< class  COLOR_BUFFER_TYPE >
+    void Rasterizer< COLOR_BUFFER_TYPE >::interpolate_depth(float* cache, int z0, int z1, int y_min, int y_max)
+    {
+        // Las Z llegan como claves del z-buffer y se interpolan como float:
+
+        if (y_max > y_min)
+        {
+            float depth = SpanFiller::get_reversed_depth(z0);
+            float step  = (SpanFiller::get_reversed_depth(z1) - depth) / float(y_max - y_min);
+
+            for (int y = y_min; y <= y_max; y++)
+            {
+                cache[y] = depth + float(y - y_min) * step;
+            }
+        }
+    }
+
 }
 
 #endif
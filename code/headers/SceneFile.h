@@ -0,0 +1,123 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Light.h"
+
+namespace MGVisualizer
+{
+    using std::vector;
+    using glm::vec3;
+
+    /// <summary>
+    /// Scene description read from a text file written by hand or from a binary file written by tools.
+    /// Both are read front to back in one pass and hold the same content.
+    ///
+    /// Text format, one statement per line, # starts a comment, paths and names have no spaces:
+    ///   camera      px py pz  rx ry rz
+    ///   ambient     r g b  intensity
+    ///   directional r g b  intensity  dx dy dz
+    ///   point       r g b  intensity  px py pz  range
+    ///   entity      name  parent|-  model_path  px py pz  rx ry rz  sx sy sz
+    ///   spin        name  rx ry rz
+    /// Parents are declared before their children. Spin gives degrees added to an entity rotation every update.
+    /// </summary>
+    class SceneFile
+    {
+    public:
+
+        struct EntityRecord
+        {
+            std::string name;
+
+            // Index in models
+            uint32_t model;
+
+            // Index of an earlier entity, -1 for roots
+            int32_t parent;
+
+            vec3 position;
+            vec3 rotation;
+            vec3 scale;
+
+            // Degrees added to rotation every update
+            vec3 spin;
+        };
+
+        struct LightRecord
+        {
+            Light::Types type;
+
+            // Color with components from 0 to 1
+            vec3  color;
+            float intensity;
+
+            // Direction of directional lights, position of point lights
+            vec3  vector;
+            float range;
+        };
+
+    public:
+
+        vec3 camera_position;
+        vec3 camera_rotation;
+
+        /// <summary>
+        /// Path of every model file, each one listed once
+        /// </summary>
+        vector< std::string > models;
+
+        /// <summary>
+        /// Entities with parents always before their children
+        /// </summary>
+        vector< EntityRecord > entities;
+
+        vector< LightRecord > lights;
+
+    public:
+
+        SceneFile() : camera_position(0.f), camera_rotation(0.f) { }
+
+        /// <summary>
+        /// Replace contents with a scene file, text or binary
+        /// </summary>
+        /// <param name="path">Path to the scene file</param>
+        /// <param name="error">Receives the reason of a failure if not null</param>
+        /// <returns>False if the file could not be read or is malformed</returns>
+        bool load(const char* path, std::string* error = nullptr);
+
+        /// <summary>
+        /// Write contents to a scene file
+        /// </summary>
+        /// <param name="path">Path to the scene file</param>
+        /// <param name="binary">True for the binary format, false for text</param>
+        /// <returns>True if the file was written</returns>
+        bool save(const char* path, bool binary) const;
+
+        /// <summary>
+        /// Index of a model path, added to the models if not listed yet
+        /// </summary>
+        uint32_t add_model(const std::string& path);
+
+        /// <summary>
+        /// Synthetic scene for load testing: the terrain of the default scene with deer on it
+        /// and clouds carrying eagles over it, every cloud spinning at its own speed
+        /// </summary>
+        /// <param name="entity_count">Number of entities, at least the terrain</param>
+        /// <param name="seed">Seed of the random placement</param>
+        static SceneFile generate_stress(unsigned entity_count, unsigned seed);
+
+    private:
+
+        bool load_text(std::istream& file, std::string* error);
+        bool load_binary(std::istream& file, std::string* error);
+    };
+}
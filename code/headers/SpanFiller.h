@@ -0,0 +1,100 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <Color.hpp>
+
+namespace MGVisualizer
+{
+    using argb::Rgb888;
+
+    /// <summary>
+    /// Kernels filling one z-buffered span of Rgb888 pixels
+    /// </summary>
+    class SpanFiller
+    {
+    public:
+
+        /// <summary>
+        /// Fill count pixels whose depth passes the test. Depth and step are 32.32 fixed point,
+        /// depth of pixel k is (z + k * z_step) >> 32 so the step keeps its fraction along the span.
+        /// </summary>
+        typedef void (*Function)(int* depths, Rgb888* pixels, int count, int64_t z, int64_t z_step, const Rgb888& color);
+
+        /// <summary>
+        /// Fill count pixels of a span with reversed float depth. Depth of pixel k is depth + k * depth_step,
+        /// compared and stored as its reversed depth key.
+        /// </summary>
+        typedef void (*Reversed_Function)(int* depths, Rgb888* pixels, int count, float depth, float depth_step, const Rgb888& color);
+
+        /// <summary>
+        /// Available implementations, from slowest to fastest
+        /// </summary>
+        enum Kernels
+        {
+            Scalar,
+            SSE2,
+            AVX2,
+
+            KernelsCount
+        };
+
+    public:
+
+        /// <summary>
+        /// Fastest kernel supported by the running CPU
+        /// </summary>
+        static Kernels get_best_kernel();
+
+        /// <summary>
+        /// Check if running CPU can execute given kernel
+        /// </summary>
+        static bool is_supported(Kernels kernel);
+
+        static Function get_function(Kernels kernel);
+
+        static Reversed_Function get_reversed_function(Kernels kernel);
+
+        static const char* get_kernel_name(Kernels kernel);
+
+        /// <summary>
+        /// Integer stored in the depth buffer for a reversed depth in [0, 1], where 1 is the near plane.
+        /// Bits of non negative floats sort like integers, subtracting them from the bits of 1
+        /// gives keys that are smaller for nearer depths like every other depth value.
+        /// </summary>
+        static int get_reversed_depth_key(float depth)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &depth, sizeof(bits));
+
+            return int(reversed_one - bits);
+        }
+
+        static float get_reversed_depth(int key)
+        {
+            uint32_t bits = reversed_one - uint32_t(key);
+
+            float depth;
+            std::memcpy(&depth, &bits, sizeof(depth));
+
+            return depth;
+        }
+
+        static constexpr uint32_t reversed_one = 0x3F800000u;
+
+    private:
+
+        static void fill_scalar(int* depths, Rgb888* pixels, int count, int64_t z, int64_t z_step, const Rgb888& color);
+        static void fill_sse2  (int* depths, Rgb888* pixels, int count, int64_t z, int64_t z_step, const Rgb888& color);
+        static void fill_avx2  (int* depths, Rgb888* pixels, int count, int64_t z, int64_t z_step, const Rgb888& color);
+
+        static void fill_reversed_scalar(int* depths, Rgb888* pixels, int count, float depth, float depth_step, const Rgb888& color);
+        static void fill_reversed_sse2  (int* depths, Rgb888* pixels, int count, float depth, float depth_step, const Rgb888& color);
+        static void fill_reversed_avx2  (int* depths, Rgb888* pixels, int count, float depth, float depth_step, const Rgb888& color);
+    };
+}
@@ -0,0 +1,98 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MGVisualizer
+{
+    using std::vector;
+
+    /// <summary>
+    /// Fixed set of worker threads sharing indexed tasks with the calling thread.
+    /// Workers also run queued background jobs when no indexed task is pending.
+    /// </summary>
+    class ThreadPool
+    {
+    public:
+
+        /// Task receiving its index and the index of the worker running it
+        typedef std::function< void(unsigned task, unsigned worker) > Task;
+
+        /// Job running in background
+        typedef std::function< void() > Job;
+
+    private:
+
+        vector< std::thread > threads;
+
+        std::mutex              mutex;
+        std::condition_variable wake_condition;
+        std::condition_variable done_condition;
+        std::condition_variable idle_condition;
+
+        // Job shared by every worker until all its tasks are taken
+        const Task*             job;
+        unsigned                taskCount;
+        std::atomic< unsigned > nextTask;
+
+        unsigned pendingThreads;
+        unsigned generation;
+        bool     stopping;
+
+        // Background jobs waiting for a worker and jobs being run
+        std::deque< Job > jobs;
+        unsigned          runningJobs;
+
+    public:
+
+        /// <summary>
+        /// Create pool of workers
+        /// </summary>
+        /// <param name="worker_count">Workers including the calling thread, 0 uses every hardware thread</param>
+        ThreadPool(unsigned worker_count = 0);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator = (const ThreadPool&) = delete;
+
+        /// <summary>
+        /// Number of workers including the calling thread
+        /// </summary>
+        unsigned get_worker_count() const { return unsigned(threads.size()) + 1; }
+
+        /// <summary>
+        /// Run task once per index and wait until every task has finished
+        /// </summary>
+        /// <param name="count">Number of tasks</param>
+        /// <param name="task">Function called with task and worker indices</param>
+        void parallel_for(unsigned count, const Task& task);
+
+        /// <summary>
+        /// Queue a job to run in a worker thread. Runs it right away if the pool has no threads.
+        /// </summary>
+        /// <param name="job">Function to run in background</param>
+        void enqueue(Job job);
+
+        /// <summary>
+        /// Wait until every queued job has finished
+        /// </summary>
+        void wait_idle();
+
+    private:
+
+        void worker_loop(unsigned worker);
+
+        void run_tasks(unsigned worker);
+    };
+}
@@ -0,0 +1,272 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "Rasterizer.h"
+#include "ThreadPool.h"
+#include "FrameArena.h"
+
+namespace MGVisualizer
+{
+    using std::vector;
+
+    /// <summary>
+    /// Rasterizer backend that bins polygons into screen tiles and fills the tiles in parallel
+    /// </summary>
+    template< class COLOR_BUFFER_TYPE >
+    class TiledRasterizer
+    {
+    public:
+
+        typedef Rasterizer< COLOR_BUFFER_TYPE >  Target;
+        typedef typename Target::Color           Color;
+        typedef typename Target::Edge_Cache      Edge_Cache;
+        typedef typename Target::Scissor         Scissor;
+
+        static constexpr int tile_size = 64;
+
+        // Workers only touch hierarchical z blocks inside their own tiles
+        static_assert(tile_size % Target::z_block_size == 0, "Tiles must be made of whole hierarchical z blocks");
+
+        // Clipped triangles never have more vertices than this
+        static constexpr int max_polygon_vertices = 10;
+
+        // Polygon indices in each piece of a bin
+        static constexpr int bin_chunk_size = 62;
+
+    private:
+
+        /// <summary>
+        /// Polygon submitted during the frame
+        /// </summary>
+        struct Polygon
+        {
+            unsigned first_vertex;
+            unsigned vertex_count;
+            Color    color;
+
+            // Filled with interpolated vertex colors
+            bool     smooth;
+        };
+
+        /// <summary>
+        /// Piece of the polygon indices binned in a tile, taken from the frame arena
+        /// </summary>
+        struct Bin_Chunk
+        {
+            Bin_Chunk* next;
+            unsigned   count;
+            unsigned   polygons[bin_chunk_size];
+        };
+
+        /// <summary>
+        /// Chunks holding the polygons of a tile, empty while both are null
+        /// </summary>
+        struct Bin
+        {
+            Bin_Chunk* first;
+            Bin_Chunk* last;
+        };
+
+    private:
+
+        Target&     rasterizer;
+        ThreadPool& pool;
+        FrameArena& arena;
+
+        int width;
+        int height;
+        int tiles_x;
+        int tiles_y;
+
+        // Polygons in submission order, their vertices and vertex colors
+        vector< Polygon > polygons;
+        vector< ivec4 >   vertices;
+        vector< Color >   vertex_colors;
+
+        // Indices of polygons overlapping each tile, in submission order. Tiles receive
+        // very different amounts of polygons each frame, chunks let them share the arena.
+        vector< Bin > bins;
+
+        // Edge caches owned by each worker
+        vector< Edge_Cache > caches;
+
+        typename ThreadPool::Task tile_task;
+
+    public:
+
+        TiledRasterizer(Target& target, ThreadPool& worker_pool, FrameArena& frame_arena)
+            :
+            rasterizer(target),
+            pool(worker_pool),
+            arena(frame_arena)
+        {
+            width   = int(target.get_color_buffer().get_width());
+            height  = int(target.get_color_buffer().get_height());
+            tiles_x = (width  + tile_size - 1) / tile_size;
+            tiles_y = (height + tile_size - 1) / tile_size;
+
+            bins.resize(size_t(tiles_x) * tiles_y, Bin{ nullptr, nullptr });
+            caches.resize(pool.get_worker_count(), Edge_Cache(unsigned(height)));
+
+            tile_task = [this](unsigned tile, unsigned worker) { fill_tile(tile, worker); };
+        }
+
+        /// <summary>
+        /// Make room in the edge caches for polygons reaching outside the color buffer
+        /// </summary>
+        /// <param name="lines">Scanlines above and below the color buffer</param>
+        void set_guard_margin(unsigned lines)
+        {
+            for (auto& cache : caches)
+                cache.resize(unsigned(height), lines);
+        }
+
+        /// <summary>
+        /// Add polygons and pixels workers rejected with the hierarchical z-buffer and reset their counters
+        /// </summary>
+        void take_occlusion_stats(unsigned& polygons, uint64_t& pixels)
+        {
+            for (auto& cache : caches)
+            {
+                polygons += cache.occluded_polygons;
+                pixels   += cache.occluded_pixels;
+
+                cache.occluded_polygons = 0;
+                cache.occluded_pixels = 0;
+            }
+        }
+
+        /// <summary>
+        /// Queue a convex polygon to be filled in the next flush, which must happen before the frame arena is reset
+        /// </summary>
+        /// <param name="polygon_vertices">Pointer to first vertex</param>
+        /// <param name="indices_begin">Pointer to first index</param>
+        /// <param name="indices_end">Pointer past the last index</param>
+        /// <param name="color">Color of the polygon</param>
+        /// <param name="polygon_colors">Pointer to first vertex color, null to fill with a single color</param>
+        void submit(const ivec4* const polygon_vertices, const int* const indices_begin, const int* const indices_end, const Color& color,
+            const Color* const polygon_colors = nullptr)
+        {
+            Polygon polygon;
+            polygon.first_vertex = unsigned(vertices.size());
+            polygon.vertex_count = unsigned(indices_end - indices_begin);
+            polygon.color        = color;
+            polygon.smooth       = polygon_colors != nullptr;
+
+            ivec2 min_corner = polygon_vertices[*indices_begin];
+            ivec2 max_corner = min_corner;
+
+            // Copy vertices in index order so the polygon is filled exactly as with its indices
+            for (const int* index = indices_begin; index < indices_end; index++)
+            {
+                const ivec4& vertex = polygon_vertices[*index];
+
+                min_corner = min(min_corner, ivec2(vertex));
+                max_corner = max(max_corner, ivec2(vertex));
+
+                vertices.push_back(vertex);
+                vertex_colors.push_back(polygon_colors != nullptr ? polygon_colors[*index] : color);
+            }
+
+            unsigned polygon_index = unsigned(polygons.size());
+            polygons.push_back(polygon);
+
+            // Half-space filling takes sub-pixel coordinates
+            int subpixel_bits = rasterizer.get_subpixel_bits();
+
+            min_corner >>= subpixel_bits;
+            max_corner >>= subpixel_bits;
+
+            // Bin polygon in every tile its bounding box touches
+            int first_x = std::max(min_corner.x, 0) / tile_size;
+            int first_y = std::max(min_corner.y, 0) / tile_size;
+            int last_x  = std::min(max_corner.x / tile_size, tiles_x - 1);
+            int last_y  = std::min(max_corner.y / tile_size, tiles_y - 1);
+
+            for (int tile_y = first_y; tile_y <= last_y; tile_y++)
+            {
+                for (int tile_x = first_x; tile_x <= last_x; tile_x++)
+                {
+                    Bin& bin = bins[tile_y * tiles_x + tile_x];
+
+                    if (bin.last == nullptr || bin.last->count == bin_chunk_size)
+                    {
+                        Bin_Chunk* chunk = arena.allocate< Bin_Chunk >(1);
+                        chunk->next  = nullptr;
+                        chunk->count = 0;
+
+                        (bin.last != nullptr ? bin.last->next : bin.first) = chunk;
+                        bin.last = chunk;
+                    }
+
+                    bin.last->polygons[bin.last->count++] = polygon_index;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Fill every queued polygon and empty the queue
+        /// </summary>
+        void flush()
+        {
+            pool.parallel_for(unsigned(bins.size()), tile_task);
+
+            polygons.clear();
+            vertices.clear();
+            vertex_colors.clear();
+
+            // Chunks are released with the frame arena
+            for (Bin& bin : bins)
+                bin.first = bin.last = nullptr;
+        }
+
+    private:
+
+        void fill_tile(unsigned tile, unsigned worker)
+        {
+            const Bin& bin = bins[tile];
+
+            if (bin.first == nullptr) return;
+
+            static const int polygon_indices[max_polygon_vertices] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+
+            Edge_Cache& cache = caches[worker];
+
+            int tile_x = int(tile) % tiles_x;
+            int tile_y = int(tile) / tiles_x;
+
+            Scissor scissor;
+            scissor.x0 = tile_x * tile_size;
+            scissor.y0 = tile_y * tile_size;
+            scissor.x1 = std::min(scissor.x0 + tile_size, width);
+            scissor.y1 = std::min(scissor.y0 + tile_size, height);
+
+            // Tiles never overlap so pixels and depths are written without locking
+            for (const Bin_Chunk* chunk = bin.first; chunk != nullptr; chunk = chunk->next)
+            {
+                for (unsigned i = 0; i < chunk->count; i++)
+                {
+                    const Polygon& polygon = polygons[chunk->polygons[i]];
+
+                    rasterizer.fill_convex_polygon_z_buffer
+                    (
+                        vertices.data() + polygon.first_vertex,
+                        polygon_indices,
+                        polygon_indices + polygon.vertex_count,
+                        polygon.color,
+                        cache,
+                        scissor,
+                        polygon.smooth ? vertex_colors.data() + polygon.first_vertex : nullptr
+                    );
+                }
+            }
+        }
+    };
+}
@@ -25,6 +25,9 @@ namespace MGVisualizer
 
 		mat4 transformationMatrix;
 
+		// Matrix changed since last clear_changed()
+		bool changed;
+
 	public:
 
 		Transform();
@@ -62,6 +65,13 @@ namespace MGVisualizer
 
 		const mat4 get_matrix() { return transformationMatrix; }
 
+		/// <summary>
+		/// Check if matrix changed since the last call to clear_changed
+		/// </summary>
+		bool has_changed() const { return changed; }
+
+		void clear_changed() { changed = false; }
+
 	private:
 
 		void update_matrix();
@@ -0,0 +1,55 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace MGVisualizer
+{
+    using namespace glm;
+
+    /// <summary>
+    /// Kernels transforming structure of arrays vertex streams several vertices at a time
+    /// </summary>
+    class VertexBatch
+    {
+    public:
+
+        /// <summary>
+        /// Transform positions by a matrix to clip space, without dividing them by w
+        /// </summary>
+        /// <param name="matrix">Composed model view projection matrix</param>
+        /// <param name="x">Pointer to first X coordinate</param>
+        /// <param name="y">Pointer to first Y coordinate</param>
+        /// <param name="z">Pointer to first Z coordinate</param>
+        /// <param name="count">Number of vertices</param>
+        /// <param name="output">Pointer to first transformed vertex</param>
+        static void transform_positions(const mat4& matrix, const float* x, const float* y, const float* z, size_t count, vec4* output);
+
+        /// <summary>
+        /// Decode octahedral normals, transform them by a matrix and normalize them
+        /// </summary>
+        /// <param name="matrix">Normal matrix</param>
+        /// <param name="normals">Pointer to first encoded normal</param>
+        /// <param name="count">Number of normals</param>
+        /// <param name="output">Pointer to first transformed normal, w is set to 0</param>
+        static void transform_normals(const mat3& matrix, const uint32_t* normals, size_t count, vec4* output);
+
+        /// <summary>
+        /// Encode a direction in 32 bits, folding the octahedron it is projected on into a square
+        /// and storing both coordinates of the square as 16 bit signed normalized values
+        /// </summary>
+        /// <param name="direction">Direction of any non zero length</param>
+        static uint32_t encode_normal(const vec3& direction);
+
+        /// <summary>
+        /// Direction of an encoded normal, not normalized
+        /// </summary>
+        static vec3 decode_normal(uint32_t normal);
+    };
+}
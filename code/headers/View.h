@@ -13,9 +13,17 @@
 #include <Color_Buffer.hpp>
 #include <glm/glm.hpp>
 #include "Rasterizer.h"
+#include "TiledRasterizer.h"
+#include "ThreadPool.h"
+#include "ModelCache.h"
 #include "Entity.h"
 #include "Camera.h"
 #include "DirectionalLight.h"
+#include "PointLight.h"
+#include "LightTable.h"
+#include "FrameStats.h"
+#include "FrameArena.h"
+#include "SceneFile.h"
 
 namespace MGVisualizer
 {
@@ -27,11 +35,14 @@ namespace MGVisualizer
 
     class View
     {
-    private:
+    public:
 
         typedef Rgb888                Color;
         typedef Color_Buffer< Color > Color_Buffer;
 
+        /// Scene loaded when no other is given, relative to the working directory
+        static constexpr const char* default_scene = "../binaries/default.mgscene";
+
     private:
 
         unsigned width;
@@ -39,39 +50,109 @@ namespace MGVisualizer
 
         Camera camera;
 
-        // Map containing each entity
-		map< std::string, Entity* > entities;
+        // Entities in one contiguous array, parents always before their children
+        vector< Entity > entities;
+
+        // Handle of each entity name, only used while setting up the scene
+        map< std::string, EntityHandle > entityIndex;
+
+        /// <summary>
+        /// Entity rotating at constant speed
+        /// </summary>
+        struct Spin
+        {
+            EntityHandle entity;
+
+            // Rotation given by the scene and degrees added to it every update
+            vec3 rotation;
+            vec3 speed;
+
+            // Degrees rotated so far, kept apart so rotation does not drift
+            vec3 angle;
+        };
+
+        // Entities animated every update
+        vector< Spin > spins;
+
+        // Threads importing models in background
+        ThreadPool loaders;
+
+        // Models shared by entities loading the same file
+        ModelCache models;
+
+        FrameStats::Clock::time_point loadStart;
+        double                        loadTime;
+        bool                          sceneLoaded;
 
         // Vector with lights
         vector< Light* > lights;
 
+        // Lights flattened for the vertex loop, rebuilt every update
+        LightTable lightTable;
+
+        // Transient data of the frame being updated and rendered
+        FrameArena frameArena;
+
         Color_Buffer               color_buffer;
         Rasterizer< Color_Buffer > rasterizer;
 
+        // Workers filling screen tiles in parallel
+        ThreadPool                      workers;
+        TiledRasterizer< Color_Buffer > tiledRasterizer;
+        bool                            tiledRendering;
+
+        // Size of the guard band relative to the viewport
+        float guardBand;
+
+        // Transform and light vertices in one pass while rendering instead of in update and render
+        bool fusedVertexStage;
+
+        // Screen size of meshes below which each coarser level of detail is used
+        vector< float > lodThresholds;
+
         glm::vec2 mouseLastPosition;
 
-        float worldRotation;
-        float cloudRotation;
+        // Timings of the last frame
+        FrameStats stats;
 
     public:
 
         /// <summary>
-        /// Create view to render entities
+        /// Create view to render entities, empty until a scene is loaded
         /// </summary>
         /// <param name="width">Window width</param>
         /// <param name="height">Window height</param>
         View(unsigned width, unsigned height);
 
+        /// <summary>
+        /// Add entities, lights, camera pose and animations of a scene file to an empty view.
+        /// Models are imported in background while the view starts rendering.
+        /// </summary>
+        /// <param name="scene_path">Path to a text or binary scene file</param>
+        /// <param name="error">Receives the reason of a failure if not null</param>
+        /// <returns>False if the scene file could not be read</returns>
+        bool load_scene(const char* scene_path, std::string* error = nullptr);
+
+        /// <summary>
+        /// Add contents of a scene already in memory to an empty view
+        /// </summary>
+        void load_scene(const SceneFile& scene);
+
         /// <summary>
         /// Update view
         /// </summary>
         void update();
 
         /// <summary>
-        /// Render every entity in the window
+        /// Render every entity in the color buffer
         /// </summary>
         void render();
 
+        /// <summary>
+        /// Copy color buffer to the active OpenGL window
+        /// </summary>
+        void present();
+
         /// <summary>
         /// Process SFML events
         /// </summary>
@@ -84,6 +165,136 @@ namespace MGVisualizer
 
         vector< Light* >& get_lights() { return lights; }
 
+        LightTable& get_light_table() { return lightTable; }
+
+        Camera* get_camera() { return &camera; }
+
+        FrameStats& get_stats() { return stats; }
+
+        FrameArena& get_frame_arena() { return frameArena; }
+
+        /// <summary>
+        /// Add an entity whose model is loaded in background, or shared if another entity already uses the file
+        /// </summary>
+        /// <param name="name">Unique name to find the entity while setting up the scene</param>
+        /// <param name="model_path">Path to 3D file</param>
+        /// <param name="parent">Handle of an entity already added, or no_entity</param>
+        /// <returns>Handle of the new entity</returns>
+        EntityHandle add_entity(const std::string& name, const char* model_path, EntityHandle parent = no_entity);
+
+        /// <summary>
+        /// Look up an entity by name, meant for setup rather than every frame
+        /// </summary>
+        /// <returns>Handle of the entity or no_entity</returns>
+        EntityHandle find_entity(const std::string& name) const;
+
+        Entity& get_entity(EntityHandle handle) { return entities[handle]; }
+
+        const vector< Entity >& get_entities() const { return entities; }
+
+        const map< std::string, EntityHandle >& get_entity_index() const { return entityIndex; }
+
+        const ModelCache& get_model_cache() const { return models; }
+
+        const Color_Buffer& get_color_buffer() const { return color_buffer; }
+
+        /// <summary>
+        /// Choose between tiled parallel rasterization and filling polygons as they come
+        /// </summary>
+        /// <param name="enabled">True to bin polygons and fill tiles in parallel</param>
+        void set_tiled_rendering(bool enabled) { tiledRendering = enabled; }
+
+        bool is_tiled_rendering() const { return tiledRendering; }
+
+        unsigned get_worker_count() const { return workers.get_worker_count(); }
+
+        /// <summary>
+        /// Choose between one pass transforming and lighting every vertex of a mesh right before rasterizing it,
+        /// and transforming vertices in update, then lighting only those of visible triangles in render
+        /// </summary>
+        /// <param name="enabled">True for the fused vertex stage</param>
+        void set_fused_vertex_stage(bool enabled) { fusedVertexStage = enabled; }
+
+        bool is_fused_vertex_stage() const { return fusedVertexStage; }
+
+        /// <summary>
+        /// Enable rejecting triangles and meshes hidden behind already rasterized ones
+        /// </summary>
+        /// <param name="enabled">True to test against the hierarchical z-buffer</param>
+        void set_occlusion_culling(bool enabled);
+
+        /// <summary>
+        /// Choose between scanline filling and fixed point half-space filling with sub-pixel vertices
+        /// </summary>
+        /// <param name="mode">Rasterizer fill mode</param>
+        void set_fill_mode(Rasterizer< Color_Buffer >::Fill_Modes mode);
+
+        Rasterizer< Color_Buffer >::Fill_Modes get_fill_mode() const { return rasterizer.get_fill_mode(); }
+
+        /// <summary>
+        /// Choose between 24 bit fixed point depth and reversed 32 bit float depth
+        /// </summary>
+        /// <param name="format">Rasterizer depth format</param>
+        void set_depth_format(Rasterizer< Color_Buffer >::Depth_Formats format);
+
+        Rasterizer< Color_Buffer >::Depth_Formats get_depth_format() const { return rasterizer.get_depth_format(); }
+
+        /// <summary>
+        /// Depth buffer value of a vertex between near and far planes
+        /// </summary>
+        /// <param name="z">Clip space z</param>
+        /// <param name="w">Clip space w</param>
+        int get_depth_key(float z, float w) const { return rasterizer.get_depth_key(z, w); }
+
+        /// <summary>
+        /// Choose between one color per triangle and interpolated vertex colors
+        /// </summary>
+        /// <param name="mode">Rasterizer shading mode</param>
+        void set_shading_mode(Rasterizer< Color_Buffer >::Shading_Modes mode);
+
+        Rasterizer< Color_Buffer >::Shading_Modes get_shading_mode() const { return rasterizer.get_shading_mode(); }
+
+        /// <summary>
+        /// Check if a mesh is hidden behind what was already rasterized this frame.
+        /// Polygons are only rasterized as they are submitted when not rendering in tiles.
+        /// </summary>
+        /// <param name="clip_matrix">Matrix from mesh coordinates to clip space</param>
+        /// <param name="viewport">Matrix from normalized device coordinates to display coordinates</param>
+        /// <param name="mesh">Mesh whose bounding box is tested</param>
+        bool is_mesh_occluded(const mat4& clip_matrix, const mat4& viewport, const Mesh& mesh);
+
+        /// <summary>
+        /// Set guard band. Triangles inside it are scissored while rasterizing, the rest are clipped.
+        /// </summary>
+        /// <param name="size">Guard band size relative to the viewport, 1 disables it</param>
+        void set_guard_band(float size);
+
+        float get_guard_band() const { return guardBand; }
+
+        /// <summary>
+        /// Set when meshes switch to coarser levels of detail
+        /// </summary>
+        /// <param name="thresholds">Decreasing fractions of viewport height the bounding sphere of a mesh
+        /// must be under to use level 1, 2... Empty to always render full detail.</param>
+        void set_lod_thresholds(const vector< float >& thresholds) { lodThresholds = thresholds; }
+
+        const vector< float >& get_lod_thresholds() const { return lodThresholds; }
+
+        /// <summary>
+        /// Check if every entity finished loading its model
+        /// </summary>
+        bool is_scene_loaded();
+
+        /// <summary>
+        /// Block until every entity finished loading its model
+        /// </summary>
+        void wait_for_scene();
+
+        /// <summary>
+        /// Milliseconds from view creation until the last model was loaded
+        /// </summary>
+        double get_load_time() const { return loadTime; }
+
         /// <summary>
         /// Set views rasterizer color
         /// </summary>
@@ -99,13 +310,33 @@ namespace MGVisualizer
         void rasterizer_fill_polygon(const ivec4* const vertices,
             const int* const indices_begin,
             const int* const indices_end);
+
+        /// <summary>
+        /// Call views rasterizer to render a polygon interpolating its vertex colors
+        /// </summary>
+        /// <param name="vertices">Pointer to first vertex</param>
+        /// <param name="colors">Pointer to the color of the first vertex, indexed like vertices</param>
+        /// <param name="indices_begin">Pointer to first index</param>
+        /// <param name="indices_end">Pointer to last index</param>
+        void rasterizer_fill_polygon(const ivec4* const vertices,
+            const Color* const colors,
+            const int* const indices_begin,
+            const int* const indices_end);
         
         /// <summary>
         /// Check if a given polygon is not facing to the camera
         /// </summary>
-        /// <param name="projected_vertices">Pointer to first vertex to check</param>
+        /// <param name="projected_vertices">Pointer to first clip space vertex to check</param>
         /// <param name="indices">Pointer to first index to check</param>
         /// <returns></returns>
         bool is_backface(const vec4* const projected_vertices, const int* const indices);
+
+        /// <summary>
+        /// Check if a given polygon is not facing to the camera from its display coordinates.
+        /// Every vertex must be in front of the camera and inside the guard band.
+        /// </summary>
+        /// <param name="display_vertices">Pointer to first display vertex to check</param>
+        /// <param name="indices">Pointer to first index to check</param>
+        bool is_backface(const ivec4* const display_vertices, const int* const indices);
     };
 }
\ No newline at end of file
@@ -0,0 +1,72 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "AllocationCounter.h"
+
+namespace
+{
+    std::atomic< uint64_t > allocationCount(0);
+    std::atomic< uint64_t > allocationBytes(0);
+
+    void* counted_allocate(size_t size)
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(size, std::memory_order_relaxed);
+
+        // Zero bytes must still give a unique pointer
+        while (true)
+        {
+            void* memory = std::malloc(size > 0 ? size : 1);
+
+            if (memory != nullptr) return memory;
+
+            std::new_handler handler = std::get_new_handler();
+
+            if (handler == nullptr) throw std::bad_alloc();
+
+            handler();
+        }
+    }
+}
+
+namespace MGVisualizer
+{
+    uint64_t AllocationCounter::get_count()
+    {
+        return allocationCount.load(std::memory_order_relaxed);
+    }
+
+    uint64_t AllocationCounter::get_bytes()
+    {
+        return allocationBytes.load(std::memory_order_relaxed);
+    }
+}
+
+// Replacements of the global allocation functions, aligned versions keep the library ones
+
+void* operator new  (size_t size) { return counted_allocate(size); }
+void* operator new[](size_t size) { return counted_allocate(size); }
+
+void* operator new  (size_t size, const std::nothrow_t&) noexcept
+{
+    try { return counted_allocate(size); } catch (...) { return nullptr; }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    try { return counted_allocate(size); } catch (...) { return nullptr; }
+}
+
+void operator delete  (void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+
+void operator delete  (void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+
+void operator delete  (void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
@@ -0,0 +1,634 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include "Benchmark.h"
+#include "AllocationCounter.h"
+#include "SpanFiller.h"
+#include "MeshOptimizer.h"
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+namespace MGVisualizer
+{
+    namespace
+    {
+        struct CameraKey
+        {
+            vec3 position;
+            vec3 rotation;
+        };
+
+        // Camera path starts and ends at the default view pose
+        const CameraKey cameraPath[] =
+        {
+            { vec3(120.f, -40.f,    0.f), vec3(10.f, 35.f, 0.f) },
+            { vec3( 60.f, -30.f,  -60.f), vec3( 5.f, 20.f, 0.f) },
+            { vec3(  0.f, -50.f, -100.f), vec3(15.f,  0.f, 0.f) },
+            { vec3( 80.f, -60.f,  -40.f), vec3(20.f, 25.f, 0.f) },
+            { vec3(120.f, -40.f,    0.f), vec3(10.f, 35.f, 0.f) },
+        };
+
+        const unsigned cameraKeysCount = sizeof(cameraPath) / sizeof(cameraPath[0]);
+
+        // Largest resident set of the process so far in bytes, 0 if unknown
+        size_t get_peak_memory()
+        {
+        #ifdef _WIN32
+            PROCESS_MEMORY_COUNTERS counters;
+
+            if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+                return size_t(counters.PeakWorkingSetSize);
+        #else
+            struct rusage usage;
+
+            // Linux gives kilobytes, macOS bytes
+            if (getrusage(RUSAGE_SELF, &usage) == 0)
+            #ifdef __APPLE__
+                return size_t(usage.ru_maxrss);
+            #else
+                return size_t(usage.ru_maxrss) * 1024;
+            #endif
+        #endif
+
+            return 0;
+        }
+    }
+
+    Benchmark::Benchmark(unsigned width, unsigned height, unsigned frames)
+        :
+        width(width),
+        height(height),
+        frames(frames > 0 ? frames : 1),
+        scenePath(View::default_scene),
+        warmupFrames(5),
+        tiledRendering(true),
+        occlusionCulling(true),
+        levelsOfDetail(true),
+        fusedVertexStage(true),
+        allocationCheck(false),
+        fillMode(Rasterizer< View::Color_Buffer >::SCANLINE_FILL),
+        depthFormat(Rasterizer< View::Color_Buffer >::FIXED_24_DEPTH),
+        shadingMode(Rasterizer< View::Color_Buffer >::FLAT_SHADING)
+    {
+    }
+
+    bool Benchmark::run()
+    {
+        View view(width, height);
+        view.set_tiled_rendering(tiledRendering);
+        view.set_occlusion_culling(occlusionCulling);
+        view.set_fused_vertex_stage(fusedVertexStage);
+        view.set_fill_mode(fillMode);
+        view.set_depth_format(depthFormat);
+        view.set_shading_mode(shadingMode);
+
+        if (not levelsOfDetail)
+            view.set_lod_thresholds({ });
+
+        std::string error;
+
+        if (not view.load_scene(scenePath.c_str(), &error))
+        {
+            std::printf("could not load scene %s: %s\n", scenePath.c_str(), error.c_str());
+            return false;
+        }
+
+        // Measure complete scene only
+        view.wait_for_scene();
+
+        // Import or cache load transients are included, frames barely add to it
+        size_t loadPeakMemory = get_peak_memory();
+
+        vector< double > frameTimes;
+        frameTimes.reserve(frames);
+
+        double stageTotals[FrameStats::StagesCount] = { };
+        double matricesTotal = 0;
+        double trianglesTotal[4] = { };
+        double trianglesBackfacing = 0;
+        double trianglesSelected = 0;
+        double trianglesFullDetail = 0;
+        double verticesRendered = 0;
+        double verticesLit = 0;
+        double verticesSkipped = 0;
+        double vertexBytesRead = 0;
+        double vertexBytesWritten = 0;
+        double meshesCulled = 0;
+        double meshesVisible = 0;
+        double meshesOccluded = 0;
+        double trianglesOccluded = 0;
+        double pixelsOccluded = 0;
+        double arenaBytes = 0;
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+        unsigned allocatingFrames = 0;
+
+        for (unsigned frame = 0; frame < warmupFrames + frames; frame++)
+        {
+            bool measured = frame >= warmupFrames;
+
+            move_camera(*view.get_camera(), measured ? frame - warmupFrames : 0);
+
+            uint64_t allocationsStart = AllocationCounter::get_count();
+            uint64_t bytesStart = AllocationCounter::get_bytes();
+
+            FrameStats::Clock::time_point start = FrameStats::Clock::now();
+
+            view.update();
+            view.render();
+
+            double frameTime = std::chrono::duration< double, std::milli >(FrameStats::Clock::now() - start).count();
+
+            uint64_t frameAllocations = AllocationCounter::get_count() - allocationsStart;
+
+            if (not measured) continue;
+
+            frameTimes.push_back(frameTime);
+
+            allocations += frameAllocations;
+            allocatedBytes += AllocationCounter::get_bytes() - bytesStart;
+            allocatingFrames += frameAllocations > 0 ? 1 : 0;
+
+            const FrameStats& stats = view.get_stats();
+
+            for (int stage = 0; stage < FrameStats::StagesCount; stage++)
+                stageTotals[stage] += stats.stageTimes[stage];
+
+            matricesTotal += stats.matricesRecomputed;
+
+            meshesCulled += stats.meshesCulled;
+            meshesVisible += stats.meshesVisible;
+            meshesOccluded += stats.meshesOccluded;
+            trianglesOccluded += stats.trianglesOccluded;
+            pixelsOccluded += double(stats.pixelsOccluded);
+
+            trianglesBackfacing += stats.trianglesBackfacing;
+            trianglesSelected += stats.trianglesSelected;
+            trianglesFullDetail += stats.trianglesFullDetail;
+            verticesRendered += stats.verticesRendered;
+            verticesLit += stats.verticesLit;
+            verticesSkipped += stats.verticesSkipped;
+            vertexBytesRead += double(stats.vertexBytesRead);
+            vertexBytesWritten += double(stats.vertexBytesWritten);
+
+            trianglesTotal[0] += stats.trianglesRejected;
+            trianglesTotal[1] += stats.trianglesInside;
+            trianglesTotal[2] += stats.trianglesScissored;
+            trianglesTotal[3] += stats.trianglesClipped;
+
+            arenaBytes += double(stats.arenaBytes);
+        }
+
+        vector< double > sorted = frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+
+        std::printf("MGSceneLoader benchmark: %ux%u, %u frames\n", width, height, frames);
+        std::printf("scene: %s, %zu entities, %zu models, %zu lights\n", scenePath.c_str(), view.get_entities().size(),
+            view.get_model_cache().get_models().size(), view.get_lights().size());
+        std::printf("scene load time: %.1f ms, peak resident memory %.1f MB\n", view.get_load_time(), loadPeakMemory / (1024.0 * 1024.0));
+
+        if (tiledRendering)
+            std::printf("rasterizer: tiled, %u workers\n", view.get_worker_count());
+        else
+            std::printf("rasterizer: serial\n");
+
+        std::printf("fill mode: %s\n", fillMode == Rasterizer< View::Color_Buffer >::HALF_SPACE_FILL ? "half-space, 24.8 fixed point" : "scanline");
+        std::printf("depth format: %s\n", get_depth_format_name(depthFormat));
+        std::printf("vertex stage: %s\n", fusedVertexStage ? "fused" : "two-phase");
+        std::printf("shading: %s\n", shadingMode == Rasterizer< View::Color_Buffer >::GOURAUD_SHADING ? "gouraud" : "flat");
+
+        std::printf("frame time (ms): min %.3f  median %.3f  p99 %.3f  max %.3f\n",
+            sorted.front(), percentile(sorted, 0.5), percentile(sorted, 0.99), sorted.back());
+
+        std::printf("stage mean (ms/frame):\n");
+
+        for (int stage = 0; stage < FrameStats::StagesCount; stage++)
+        {
+            std::printf("  %-18s %.3f\n", FrameStats::get_stage_name(FrameStats::Stages(stage)), stageTotals[stage] / frames);
+        }
+
+        std::printf("world matrices recomputed per frame: %.1f\n", matricesTotal / frames);
+
+        std::printf("meshes per frame: visible %.1f  culled %.1f  occluded %.1f\n", meshesVisible / frames, meshesCulled / frames, meshesOccluded / frames);
+
+        std::printf("hierarchical z: %s, rejected per frame %.0f polygons  ~%.0f pixels\n", occlusionCulling ? "on" : "off",
+            trianglesOccluded / frames, pixelsOccluded / frames);
+
+        std::printf("levels of detail thresholds:");
+
+        for (float threshold : view.get_lod_thresholds())
+            std::printf(" %.3f", threshold);
+
+        std::printf("%s\n", view.get_lod_thresholds().empty() ? " none" : "");
+
+        std::printf("triangles per frame at selected detail %.0f of %.0f at full detail\n", trianglesSelected / frames, trianglesFullDetail / frames);
+
+        std::printf("vertices per frame: rendered %.0f  lit %.0f  unused by visible triangles %.0f\n",
+            verticesRendered / frames, verticesLit / frames, verticesSkipped / frames);
+
+        // Both vertex stages divided by the same vertices so they can be compared
+        std::printf("vertex stage streams per rendered vertex: read %.1f bytes  written %.1f bytes\n",
+            vertexBytesRead / std::max(verticesRendered, 1.0), vertexBytesWritten / std::max(verticesRendered, 1.0));
+
+        std::printf("triangles per frame: backfacing %.0f  rejected %.0f  inside %.0f  guard band %.0f  clipped %.0f\n",
+            trianglesBackfacing / frames, trianglesTotal[0] / frames, trianglesTotal[1] / frames, trianglesTotal[2] / frames, trianglesTotal[3] / frames);
+
+        std::printf("frame arena: %.1f KB per frame, peak %.1f KB, capacity %.1f KB\n", arenaBytes / frames / 1024.0,
+            view.get_frame_arena().get_peak() / 1024.0, view.get_frame_arena().get_capacity() / 1024.0);
+
+        // Buffers may still grow while the path shows more triangles than the warmup pose
+        std::printf("heap allocations per frame: %.2f (%.0f bytes), %u of %u frames allocated\n",
+            double(allocations) / frames, double(allocatedBytes) / frames, allocatingFrames, frames);
+
+        // Transient vertex streams live in the frame arena, only persistent ones are counted
+        std::printf("mesh memory per model, entities / vertices / bytes per vertex / vertex KB / index KB:\n");
+
+        for (const auto& [path, model] : view.get_model_cache().get_models())
+        {
+            // Each entity drawing the model is an instance sharing its meshes
+            unsigned instances = 0;
+
+            for (const Entity& entity : view.get_entities())
+                instances += entity.get_model() == model ? 1 : 0;
+
+            size_t vertices = 0;
+            size_t vertexBytes = 0;
+            size_t indexBytes = 0;
+
+            for (const Mesh& mesh : model->meshes)
+            {
+                vertices += mesh.get_vertex_count();
+                vertexBytes += mesh.get_vertex_bytes();
+                indexBytes += mesh.get_index_bytes();
+            }
+
+            if (vertices > 0)
+                std::printf("  %-24s %5u %8zu %6.1f %10.1f %10.1f\n", path.c_str(), instances, vertices, double(vertexBytes) / vertices,
+                    vertexBytes / 1024.0, indexBytes / 1024.0);
+        }
+
+        std::printf("vertex cache ACMR (FIFO %u), imported -> optimized:\n", MeshOptimizer::cache_size);
+
+        for (const auto& [path, model] : view.get_model_cache().get_models())
+        {
+            double triangles = 0;
+            double importedMisses = 0;
+            double optimizedMisses = 0;
+
+            for (const Mesh& mesh : model->meshes)
+            {
+                double meshTriangles = double(mesh.original_indices.size() / 3);
+
+                triangles += meshTriangles;
+                importedMisses += mesh.imported_acmr * meshTriangles;
+                optimizedMisses += MeshOptimizer::compute_acmr(mesh.original_indices.data(), mesh.original_indices.size(), mesh.get_vertex_count()) * meshTriangles;
+            }
+
+            if (triangles > 0)
+                std::printf("  %-24s %.3f -> %.3f\n", path.c_str(), importedMisses / triangles, optimizedMisses / triangles);
+        }
+
+        // Same scene and path must give the same checksum with every backend
+        const auto& color_buffer = view.get_color_buffer();
+
+        std::printf("last frame checksum: %08x\n", checksum(reinterpret_cast< const unsigned char* >(color_buffer.pixels()),
+            color_buffer.get_size() * sizeof(*color_buffer.pixels())));
+
+        if (not allocationCheck) return true;
+
+        // Every buffer already grew for the path, replaying it must not touch the heap
+        uint64_t steadyAllocations = 0;
+        unsigned steadyAllocatingFrames = 0;
+
+        for (unsigned frame = 0; frame < frames; frame++)
+        {
+            move_camera(*view.get_camera(), frame);
+
+            uint64_t allocationsStart = AllocationCounter::get_count();
+
+            view.update();
+            view.render();
+
+            uint64_t frameAllocations = AllocationCounter::get_count() - allocationsStart;
+
+            steadyAllocations += frameAllocations;
+            steadyAllocatingFrames += frameAllocations > 0 ? 1 : 0;
+        }
+
+        bool passed = steadyAllocations == 0;
+
+        std::printf("steady state allocation check: %s, %llu allocations in %u of %u frames\n", passed ? "passed" : "FAILED",
+            (unsigned long long)steadyAllocations, steadyAllocatingFrames, frames);
+
+        return passed;
+    }
+
+    void Benchmark::run_span_kernels()
+    {
+        const int   bufferSize = 1 << 20;
+        const int   spanLengths[] = { 7, 1024 };
+        const Rgb888 color(1.f, 0.5f, 0.25f);
+
+        vector< int >    depths(bufferSize);
+        vector< Rgb888 > pixels(bufferSize);
+
+        std::printf("span kernels (every pixel passes the depth test):\n");
+
+        for (int length : spanLengths)
+        {
+            int spans = bufferSize / length;
+
+            for (int kernel = 0; kernel < SpanFiller::KernelsCount; kernel++)
+            {
+                if (not SpanFiller::is_supported(SpanFiller::Kernels(kernel))) continue;
+
+                SpanFiller::Function fill = SpanFiller::get_function(SpanFiller::Kernels(kernel));
+
+                std::fill(depths.begin(), depths.end(), std::numeric_limits< int >::max());
+
+                const int repetitions = 50;
+
+                FrameStats::Clock::time_point start = FrameStats::Clock::now();
+
+                // Each repetition is closer than the previous one so every pixel is written
+                for (int repetition = 0; repetition < repetitions; repetition++)
+                {
+                    int64_t z = int64_t(1000000 - repetition * 1000) << 32;
+
+                    for (int span = 0; span < spans; span++)
+                        fill(depths.data() + span * length, pixels.data() + span * length, length, z, -(int64_t(1) << 32), color);
+                }
+
+                double seconds = std::chrono::duration< double >(FrameStats::Clock::now() - start).count();
+                double pixelCount = double(repetitions) * spans * length;
+
+                std::printf("  length %4d  %-6s %8.1f Mpixels/s  %8.2f ns/span\n", length, SpanFiller::get_kernel_name(SpanFiller::Kernels(kernel)),
+                    pixelCount / seconds * 1e-6, seconds * 1e9 / (double(repetitions) * spans));
+            }
+        }
+
+        std::printf("reversed float depth span kernels (every pixel passes the depth test):\n");
+
+        for (int length : spanLengths)
+        {
+            int spans = bufferSize / length;
+
+            for (int kernel = 0; kernel < SpanFiller::KernelsCount; kernel++)
+            {
+                if (not SpanFiller::is_supported(SpanFiller::Kernels(kernel))) continue;
+
+                SpanFiller::Reversed_Function fill = SpanFiller::get_reversed_function(SpanFiller::Kernels(kernel));
+
+                std::fill(depths.begin(), depths.end(), std::numeric_limits< int >::max());
+
+                const int repetitions = 50;
+
+                FrameStats::Clock::time_point start = FrameStats::Clock::now();
+
+                // Reversed depth grows towards the camera
+                for (int repetition = 0; repetition < repetitions; repetition++)
+                {
+                    float depth = 0.01f + repetition * 0.01f;
+
+                    for (int span = 0; span < spans; span++)
+                        fill(depths.data() + span * length, pixels.data() + span * length, length, depth, 1e-7f, color);
+                }
+
+                double seconds = std::chrono::duration< double >(FrameStats::Clock::now() - start).count();
+                double pixelCount = double(repetitions) * spans * length;
+
+                std::printf("  length %4d  %-6s %8.1f Mpixels/s  %8.2f ns/span\n", length, SpanFiller::get_kernel_name(SpanFiller::Kernels(kernel)),
+                    pixelCount / seconds * 1e-6, seconds * 1e9 / (double(repetitions) * spans));
+            }
+        }
+    }
+
+    void Benchmark::run_fill_modes()
+    {
+        typedef Rasterizer< View::Color_Buffer > Target;
+
+        const unsigned width = 1024;
+        const unsigned height = 768;
+        const float    sizes[] = { 4.f, 32.f, 256.f };
+        const unsigned triangles = 20000;
+
+        View::Color_Buffer color_buffer(width, height);
+        Target             rasterizer(color_buffer);
+
+        vector< Rgb888 > reference(color_buffer.get_size());
+
+        // Depths come from the camera projection so both formats get the same range they get when rendering
+        Camera camera;
+        mat4   projection = camera.get_projection_matrix(float(width) / height);
+
+        rasterizer.set_near_plane(camera.get_near_plane());
+
+        std::printf("fill modes (%u random triangles per size, flat pixels compared against scanline with fixed depth):\n", triangles);
+
+        for (float size : sizes)
+        {
+            // Same triangles, at pixel positions and at sub-pixel positions, for every mode
+            std::mt19937 random(1234);
+            std::uniform_real_distribution< float > position(0.f, 1.f);
+            std::uniform_real_distribution< float > offset(-size, size);
+            std::uniform_real_distribution< float > distance(2.f, 90.f);
+
+            vector< vec4 >   corners(triangles * 3);
+            vector< Rgb888 > colors(triangles * 3);
+
+            for (unsigned triangle = 0; triangle < triangles; triangle++)
+            {
+                vec2 center(position(random) * width, position(random) * height);
+
+                for (unsigned corner = 0; corner < 3; corner++)
+                {
+                    vec2 screen = center + vec2(offset(random), offset(random));
+                    vec4 clip   = projection * vec4(0.f, 0.f, -distance(random), 1.f);
+
+                    // Polygons reach the rasterizer already clipped, corners are kept inside the buffer
+                    screen = min(max(screen, vec2(0.f)), vec2(width - 1, height - 1));
+
+                    corners[triangle * 3 + corner] = vec4(screen, clip.z, clip.w);
+                    colors [triangle * 3 + corner] = Rgb888(position(random), position(random), position(random));
+                }
+            }
+
+            const int indices[] = { 0, 1, 2 };
+
+            // Both fill modes with each depth format and flat shading, then with Gouraud shading
+            for (int run = 0; run < 6; run++)
+            {
+                int  format = run < 4 ? run / 2 : Target::FIXED_24_DEPTH;
+                int  mode = run % 2;
+                bool smooth = run >= 4;
+
+                rasterizer.set_fill_mode(Target::Fill_Modes(mode));
+                rasterizer.set_depth_format(Target::Depth_Formats(format));
+                rasterizer.set_shading_mode(smooth ? Target::GOURAUD_SHADING : Target::FLAT_SHADING);
+                rasterizer.clear();
+
+                float subpixel = float(1 << rasterizer.get_subpixel_bits());
+
+                vector< ivec4 > vertices(corners.size());
+
+                // Corners hold screen x and y with clip space z and w
+                for (size_t vertex = 0; vertex < corners.size(); vertex++)
+                {
+                    vertices[vertex] = ivec4(int(corners[vertex].x * subpixel), int(corners[vertex].y * subpixel), rasterizer.get_depth_key(corners[vertex].z, corners[vertex].w), 1);
+                }
+
+                FrameStats::Clock::time_point start = FrameStats::Clock::now();
+
+                for (unsigned triangle = 0; triangle < triangles; triangle++)
+                {
+                    if (smooth)
+                        rasterizer.fill_convex_polygon_z_buffer(vertices.data() + triangle * 3, colors.data() + triangle * 3, indices, indices + 3);
+                    else
+                    {
+                        rasterizer.set_color(colors[triangle * 3]);
+                        rasterizer.fill_convex_polygon_z_buffer(vertices.data() + triangle * 3, indices, indices + 3);
+                    }
+                }
+
+                double seconds = std::chrono::duration< double >(FrameStats::Clock::now() - start).count();
+
+                std::printf("  size %5.0f  %-10s %-14s %-7s %8.2f Mtriangles/s", size, mode == Target::SCANLINE_FILL ? "scanline" : "half-space",
+                    get_depth_format_name(Target::Depth_Formats(format)), smooth ? "gouraud" : "flat", triangles / seconds * 1e-6);
+
+                if (smooth)
+                {
+                    std::printf("\n");
+                    continue;
+                }
+
+                // Flat scanline output is the reference
+                size_t differences = 0;
+
+                for (size_t pixel = 0; pixel < reference.size(); pixel++)
+                {
+                    if (run == 0)
+                        reference[pixel] = color_buffer.pixels()[pixel];
+                    else if (std::memcmp(&reference[pixel], &color_buffer.pixels()[pixel], sizeof(Rgb888)) != 0)
+                        differences++;
+                }
+
+                std::printf("  %6.2f%% pixels differ\n", 100.0 * double(differences) / double(reference.size()));
+            }
+        }
+    }
+
+    void Benchmark::run_depth_formats()
+    {
+        typedef Rasterizer< View::Color_Buffer > Target;
+
+        const float  distances[] = { 2.f, 10.f, 25.f, 50.f, 75.f, 99.f };
+        const double separations[] = { 1e-5, 1e-6 };
+        const int    pairs = 1000;
+
+        View::Color_Buffer color_buffer(1, 1);
+        Target             rasterizer(color_buffer);
+        Camera             camera;
+
+        // Oblique pose of the camera path, so clip coordinates get the rounding of a full transform
+        camera.transform.set_position(cameraPath[1].position);
+        camera.transform.set_rotation(cameraPath[1].rotation);
+
+        mat4 projection = camera.get_projection_matrix(1.f) * inverse(camera.transform.get_matrix());
+        vec3 eye = camera.transform.get_position();
+        vec3 forward = camera.transform.get_forward();
+
+        rasterizer.set_near_plane(camera.get_near_plane());
+
+        std::printf("depth formats (%d pairs of surfaces per distance along the view direction, percentage drawn in the right order):\n", pairs);
+
+        for (float distance : distances)
+        {
+            std::printf("  distance %5.1f", distance);
+
+            for (double separation : separations)
+            {
+                std::printf("   separation %g:", separation);
+
+                for (int format = 0; format < 2; format++)
+                {
+                    rasterizer.set_depth_format(Target::Depth_Formats(format));
+
+                    auto key = [&](float eye_distance)
+                    {
+                        vec4 clip = projection * vec4(eye + forward * eye_distance, 1.f);
+
+                        return rasterizer.get_depth_key(clip.z, clip.w);
+                    };
+
+                    int ordered = 0;
+
+                    // Second surface of each pair is behind the first one by a fraction of their distance
+                    for (int pair = 0; pair < pairs; pair++)
+                    {
+                        float front = distance * (1.f - 1e-5f * float(pair));
+                        float back = front * float(1.0 + separation);
+
+                        if (key(back) > key(front)) ordered++;
+                    }
+
+                    std::printf("  %s %5.1f%%", get_depth_format_name(Target::Depth_Formats(format)), 100.0 * ordered / pairs);
+                }
+            }
+
+            std::printf("\n");
+        }
+    }
+
+    const char* Benchmark::get_depth_format_name(Rasterizer< View::Color_Buffer >::Depth_Formats format)
+    {
+        return format == Rasterizer< View::Color_Buffer >::FLOAT_REVERSED_DEPTH ? "float reversed" : "24 bit fixed";
+    }
+
+    void Benchmark::move_camera(Camera& camera, unsigned frame)
+    {
+        // Travel whole path during the measured frames
+        float t = frames > 1 ? float(frame) / float(frames - 1) : 0.f;
+        float segment = t * (cameraKeysCount - 1);
+
+        unsigned key = std::min(unsigned(segment), cameraKeysCount - 2);
+        float alpha = segment - float(key);
+
+        camera.transform.set_position(mix(cameraPath[key].position, cameraPath[key + 1].position, alpha));
+        camera.transform.set_rotation(mix(cameraPath[key].rotation, cameraPath[key + 1].rotation, alpha));
+    }
+
+    unsigned Benchmark::checksum(const unsigned char* bytes, size_t size)
+    {
+        // FNV-1a
+        unsigned hash = 2166136261u;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    double Benchmark::percentile(const vector< double >& sorted_values, double fraction)
+    {
+        // Nearest rank percentile
+        size_t rank = size_t(fraction * (sorted_values.size() - 1) + 0.5);
+
+        return sorted_values[std::min(rank, sorted_values.size() - 1)];
+    }
+}
@@ -1,49 +1,109 @@
-
 #include "Clipper.h"
 
 namespace MGVisualizer
 {
-    int Clipper::clip(const ivec4* vertices, int* first_index, int* last_index, ivec4* clipped_vertices, int width, int height)
+    void Clipper::compute_codes(const vec4* vertices, size_t count, float guard_band, uint16_t* codes)
     {
-        // Auxiliar array to keep vertices in each plane
-        ivec4 aux_vertices[10];
-        int clipped_indices[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+        for (size_t index = 0; index < count; index++)
+        {
+            const vec4& v = vertices[index];
+
+            float guard_w = guard_band * v.w;
+            unsigned code = 0;
+
+            if (v.z < -v.w) code |= Near;
+            if (v.z >  v.w) code |= Far;
+
+            if (v.x < -v.w) code |= Left;
+            if (v.x >  v.w) code |= Right;
+            if (v.y < -v.w) code |= Bottom;
+            if (v.y >  v.w) code |= Top;
 
-        // Clip polygon with left border
-        int n = clip_against_line(vertices, first_index, last_index, aux_vertices, 1.f, 0.f, 0.f);
+            if (v.x < -guard_w) code |= GuardLeft;
+            if (v.x >  guard_w) code |= GuardRight;
+            if (v.y < -guard_w) code |= GuardBottom;
+            if (v.y >  guard_w) code |= GuardTop;
 
-        // Clip polygon with bottom border
-        n = clip_against_line(aux_vertices, clipped_indices, clipped_indices + n, clipped_vertices, 0.f, -1.f, (float)height);
+            codes[index] = uint16_t(code);
+        }
+    }
 
-        // Clip polygon with right border
-        n = clip_against_line(clipped_vertices, clipped_indices, clipped_indices + n, aux_vertices, -1.f, 0.f, float(width));
+    int Clipper::clip(const vec4* vertices, const int* first_index, const int* last_index, unsigned planes, float guard_band, vec4* clipped_vertices)
+    {
+        return clip(vertices, nullptr, first_index, last_index, planes, guard_band, clipped_vertices, nullptr);
+    }
 
-        // Clip polygon with top border
-        n = clip_against_line(aux_vertices, clipped_indices, clipped_indices + n, clipped_vertices, 0.f, 1.f, 0.f);
+    int Clipper::clip(const vec4* vertices, const vec3* colors, const int* first_index, const int* last_index, unsigned planes, float guard_band,
+        vec4* clipped_vertices, vec3* clipped_colors)
+    {
+        // Auxiliar arrays to keep vertices in each plane
+        vec4 aux_vertices[max_vertices];
+        vec3 aux_colors[max_vertices];
+
+        int n = 0;
+
+        for (const int* index = first_index; index < last_index; index++)
+        {
+            if (colors != nullptr)
+                clipped_colors[n] = colors[*index];
+
+            clipped_vertices[n++] = vertices[*index];
+        }
+
+        // Each plane keeps vertices where dot(plane, vertex) >= 0
+        const struct { Codes code; vec4 plane; } clip_planes[] =
+        {
+            { Near,        vec4( 0.f,  0.f,  1.f, 1.f        ) },
+            { Far,         vec4( 0.f,  0.f, -1.f, 1.f        ) },
+            { GuardLeft,   vec4( 1.f,  0.f,  0.f, guard_band ) },
+            { GuardRight,  vec4(-1.f,  0.f,  0.f, guard_band ) },
+            { GuardBottom, vec4( 0.f,  1.f,  0.f, guard_band ) },
+            { GuardTop,    vec4( 0.f, -1.f,  0.f, guard_band ) },
+        };
+
+        // Only clip against planes some vertex is outside of
+        for (const auto& clip_plane : clip_planes)
+        {
+            if (not (planes & clip_plane.code)) continue;
+
+            n = clip_against_plane(clipped_vertices, colors != nullptr ? clipped_colors : nullptr, n, aux_vertices, aux_colors, clip_plane.plane);
+
+            for (int i = 0; i < n; i++)
+                clipped_vertices[i] = aux_vertices[i];
+
+            if (colors != nullptr)
+            {
+                for (int i = 0; i < n; i++)
+                    clipped_colors[i] = aux_colors[i];
+            }
+
+            if (n < 3) return 0;
+        }
 
         return n;
     }
 
-    int Clipper::clip_against_line(const ivec4* vertices, int* first_index, int* last_index, ivec4* clipped_vertices, float a, float b, float c)
+    int Clipper::clip_against_plane(const vec4* vertices, const vec3* colors, int count, vec4* clipped_vertices, vec3* clipped_colors, const vec4& plane)
     {
         int n = 0;
 
         // Iterate polygon vertices
-        for (int* index = first_index; index < last_index; index++)
+        for (int index = 0; index < count; index++)
         {
-            ivec4 v1 = vertices[*index];
-
             // If next index is the last one v2 is first
-			ivec4 v2 = vertices[index < last_index - 1 ? *(index + 1) : *first_index];
+            int next = index < count - 1 ? index + 1 : 0;
+
+            const vec4& v1 = vertices[index];
+            const vec4& v2 = vertices[next];
 
-            float vertex1_side = a * v1.x + b * v1.y + c;
-            float vertex2_side = a * v2.x + b * v2.y + c;
+            float vertex1_side = dot(plane, v1);
+            float vertex2_side = dot(plane, v2);
 
             // Both vertices are inside 
             if (vertex1_side >= 0 && vertex2_side >= 0)
             {
+                if (colors != nullptr) clipped_colors[n] = colors[next];
                 clipped_vertices[n++] = v2;
-                continue;
             }
             // Both are outside
             else if (vertex1_side < 0 && vertex2_side < 0)
@@ -53,33 +113,26 @@ namespace MGVisualizer
             // First is outside and second is inside
             else if (vertex1_side < 0)
             {
-                ivec4 intersection_point = line_intersection(a, b, c, v1, v2);
-                clipped_vertices[n++] = intersection_point;
+                // Sides have opposite signs here so the division is safe.
+                // Colors are interpolated in clip space like positions
+                float t = vertex1_side / (vertex1_side - vertex2_side);
+
+                if (colors != nullptr) clipped_colors[n] = mix(colors[index], colors[next], t);
+                clipped_vertices[n++] = mix(v1, v2, t);
+
+                if (colors != nullptr) clipped_colors[n] = colors[next];
                 clipped_vertices[n++] = v2;
-                continue;
             }
             // First is inside and second its outside
             else
             {
-                ivec4 intersection_point = line_intersection(a, b, c, v1, v2);
-                clipped_vertices[n++] = intersection_point;
+                float t = vertex1_side / (vertex1_side - vertex2_side);
+
+                if (colors != nullptr) clipped_colors[n] = mix(colors[index], colors[next], t);
+                clipped_vertices[n++] = mix(v1, v2, t);
             }
         }
 
         return n;
     }
-
-    // Calculate intersection of two lines given by general ecuation and two points
-    ivec4 Clipper::line_intersection(float a, float b, float c, const ivec4& point0, const ivec4& point1)
-    {
-		float divisor = (a * (point1.x - point0.x) + b * (point1.y - point0.y));
-
-        float t = (-a * point0.x - b * point0.y - c) / divisor;
-
-        float x = point0.x + (point1.x - point0.x) * t;
-        float y = point0.y + (point1.y - point0.y) * t;
-        float z = point0.z + (point1.z - point0.z) * t;
-
-        return ivec4(x, y, z, 1.f);
-    }
-}
\ No newline at end of file
+}
@@ -6,341 +6,526 @@
 #include "Entity.h"
 #include "View.h"
 #include "Clipper.h"
+#include "Frustum.h"
+#include "VertexBatch.h"
 
 namespace MGVisualizer
 {
-	Entity::Entity(const char* model_path, Entity* parent_entity)
+	namespace
+	{
+		// Bytes of a vertex in the mesh streams, position and octahedral normal
+		const size_t meshVertexBytes = 3 * sizeof(float) + sizeof(uint32_t);
+	}
+
+	Entity::Entity(std::shared_ptr< const ModelCache::Model > entity_model, EntityHandle parent_entity)
+		:
+		model(std::move(entity_model))
 	{
 		transform = Transform();
 		parent = parent_entity;
 
-		load_model_nodes(model_path);
+		worldMatrix = mat4(1);
+		worldVersion = 0;
+		parentVersion = 0;
+
+		ready = false;
+	}
+
+	bool Entity::acquire_meshes()
+	{
+		// Meshes are shared, only the state of this entity drawing them is its own
+		if (not ready && model->is_loaded())
+		{
+			meshStates.resize(model->meshes.size());
+			ready = true;
+		}
+
+		return ready;
 	}
 
-    void Entity::load_model_nodes(const char* model_path)
+    void Entity::update(mat4 projection, View* view)
     {
-        // Create assimp importer
-        Assimp::Importer importer;
+        // Placeholder until its model is loaded
+        if (not acquire_meshes()) return;
 
-        // Read 3D file scene
-        auto scene = importer.ReadFile
-        (
-            model_path,
-            aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType | aiProcess_GenNormals
-        );
+        FrameStats& stats = view->get_stats();
+        const vector< float >& lod_thresholds = view->get_lod_thresholds();
 
-        if (scene && scene->mNumMeshes > 0)
-        {
-            aiNode* root = scene->mRootNode;
+        // Apply world and projection transformations
+        mat4 transformation = projection * worldMatrix;
 
-            // Iterate each aiNode to render model properly
-            copy_nodes_recursive(root, scene, root->mTransformation);
-        }
-    }
+        clipMatrix = transformation;
 
-    void Entity::copy_nodes_recursive(aiNode* node, const aiScene* scene, aiMatrix4x4 parentTransform)
-    {
-        // If node has meshes copy them
-        if (node->mNumMeshes > 0)
-        {
-            copy_meshes(node, scene, parentTransform);
-        }
+        // Since we only need world normals we dont multiply projection
+        mat3 normalMatrix = transpose(inverse(mat3(worldMatrix)));
 
-        // Copy nodes foreach child in node
-        for (unsigned i = 0; i < node->mNumChildren; i++)
-        {
-            copy_nodes_recursive(node->mChildren[i], scene, parentTransform * node->mTransformation);
-        }
-    }
+        // Frustum planes in model space, so bounds are tested without transforming them
+        Frustum frustum(transformation);
 
-    void Entity::copy_meshes(aiNode* node, const aiScene* scene, aiMatrix4x4 parentTransform)
-    {
-        for (unsigned i = 0; i < node->mNumMeshes; i++)
-        {
-            // Make a MGMesh for each mesh in node
-            Mesh mgMesh;
+        // Camera rotation keeps the length of the projection Y row, it is the vertical focal length
+        float focal_length = length(vec3(projection[0][1], projection[1][1], projection[2][1]));
 
-            // Get mesh
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        // Largest scale of world matrix to measure bounding spheres in world units
+        float world_scale = std::max(length(vec3(worldMatrix[0])), std::max(length(vec3(worldMatrix[1])), length(vec3(worldMatrix[2]))));
 
-            // Get number of vertices and resize proper vectors
-            size_t vertices_number = mesh->mNumVertices;
+        size_t meshes_number = meshStates.size();
 
-            mgMesh.original_vertices.resize(vertices_number);
-            mgMesh.original_colors.resize(vertices_number);
-            mgMesh.original_normals.resize(vertices_number);
-            mgMesh.transformed_vertices.resize(vertices_number);
-            mgMesh.transformed_normals.resize(vertices_number);
-            mgMesh.display_vertices.resize(vertices_number);
-            mgMesh.computed_colors.resize(vertices_number);
+        // Iterate all meshes
+        for (int i = 0; i < meshes_number; i++)
+        {
+            const Mesh* mesh = &model->meshes[i];
+            MeshState* state = &meshStates[i];
 
-            // Get number of triangles and resize proper vectors
-            size_t triangles_number = mesh->mNumFaces;
+            // Sphere rejects cheaply, box is tighter for the rest
+            state->visible = frustum.intersects_sphere(mesh->sphere_center, mesh->sphere_radius) &&
+                            frustum.intersects_box(mesh->bounds_min, mesh->bounds_max);
 
-            mgMesh.original_indices.resize(triangles_number * 3);
+            if (not state->visible)
+            {
+                stats.meshesCulled++;
+                continue;
+            }
 
-            // Get color of mesh
-            aiColor4D diffuse_color;
+            stats.meshesVisible++;
 
-            // Get material of mesh
-            auto material = scene->mMaterials[mesh->mMaterialIndex];
-            aiGetMaterialColor(material, AI_MATKEY_COLOR_DIFFUSE, &diffuse_color);
+            // Fraction of viewport height covered by the bounding sphere picks the level of detail
+            float radius = mesh->sphere_radius * world_scale;
+            float distance = (transformation * vec4(mesh->sphere_center, 1.f)).w;
 
-            // Calculate transformation
-            mat4 transformation = aiToGlm(parentTransform) * aiToGlm(node->mTransformation);
+            state->lod = 0;
 
-            // Iterate every vertex in mesh
-            for (size_t index = 0; index < mesh->mNumVertices; index++)
+            if (distance > radius)
             {
-                // Copy vertex coordinates
-                auto& vertex = mesh->mVertices[index];
-                mgMesh.original_vertices[index] = transformation * vec4(vertex.x, vertex.y, vertex.z, 1.f);
+                float screen_size = radius * focal_length / distance;
 
-                // Copy color coordinates
-                mgMesh.original_colors[index].set(diffuse_color.r, diffuse_color.g, diffuse_color.b);
-
-                auto& normal = mesh->mNormals[index];
-                mgMesh.original_normals[index] = transformation * vec4(normal.x, normal.y, normal.z, 0.f);
+                while (state->lod < mesh->lods.size() && state->lod < lod_thresholds.size() && screen_size < lod_thresholds[state->lod])
+                    state->lod++;
             }
 
-            auto indices_iterator = mgMesh.original_indices.begin();
+            stats.trianglesFullDetail += unsigned(mesh->original_indices.size() / 3);
+            stats.trianglesSelected += unsigned(mesh->get_lod_indices(state->lod).size() / 3);
 
-            // Generate indexes of triangles
-            for (size_t index = 0; index < mesh->mNumFaces; index++)
-            {
-                auto& face = mesh->mFaces[index];
+            // Fused vertex stage runs while rendering, once the mesh is known not to be occluded
+            if (view->is_fused_vertex_stage()) continue;
 
-                // Make sure mesh is properly triangulated
-                assert(face.mNumIndices == 3);
+            // Coarser levels only use the first vertices
+            size_t number_of_vertices = mesh->get_lod_vertex_count(state->lod);
 
-                auto indices = face.mIndices;
+            FrameArena& arena = view->get_frame_arena();
 
-                *indices_iterator++ = (int(indices[0]));
-                *indices_iterator++ = (int(indices[1]));
-                *indices_iterator++ = (int(indices[2]));
-            }
+            state->transformed_vertices = arena.allocate< vec4 >(number_of_vertices);
+            state->clip_codes = arena.allocate< uint16_t >(number_of_vertices);
+            state->transformed_normals = arena.allocate< vec4 >(number_of_vertices);
+
+            // Transform vertices to clip space
+            VertexBatch::transform_positions(transformation,
+                mesh->positions_x.data(), mesh->positions_y.data(), mesh->positions_z.data(),
+                number_of_vertices, state->transformed_vertices);
+
+            Clipper::compute_codes(state->transformed_vertices, number_of_vertices, view->get_guard_band(), state->clip_codes);
 
-            meshes.push_back(mgMesh);
+            // Transform normals to world space
+            VertexBatch::transform_normals(normalMatrix, mesh->normals.data(), number_of_vertices, state->transformed_normals);
+
+            // Clip space vertices, codes and world normals wait in the arena until rendering
+            stats.vertexBytesRead    += number_of_vertices * meshVertexBytes;
+            stats.vertexBytesWritten += number_of_vertices * (sizeof(vec4) + sizeof(uint16_t) + sizeof(vec4));
         }
     }
 
-    void Entity::update(mat4 projection)
+    // Give vector of lights
+    void Entity::render(mat4 transformation, View* view)
     {
-        // Apply parent and projection transformations
-        mat4 parentMatrix = get_parent_matrix();
+        FrameStats& stats = view->get_stats();
+        FrameArena& arena = view->get_frame_arena();
+
+        bool fused = view->is_fused_vertex_stage();
 
-        mat4 transformation = projection * parentMatrix * transform.get_matrix();
+        mat3 normalMatrix = transpose(inverse(mat3(worldMatrix)));
 
-        size_t meshes_number = meshes.size();
+        size_t meshes_number = meshStates.size();
 
         // Iterate all meshes
         for (int i = 0; i < meshes_number; i++)
         {
-            Mesh* mesh = &meshes[i];
+            const Mesh* mesh = &model->meshes[i];
+            MeshState* state = &meshStates[i];
 
-            size_t number_of_vertices = mesh->original_vertices.size();
+            // Culled in update
+            if (not state->visible) continue;
 
-            // Transform every vertex by transformation matrix
-            for (size_t index = 0; index < number_of_vertices; index++)
+            // Hidden behind meshes rendered before
+            if (view->is_mesh_occluded(clipMatrix, transformation, *mesh))
             {
-                // Save transformed vertex in transformed vertices vector
-                vec4& vertex = mesh->transformed_vertices[index] =
-                    transformation * mesh->original_vertices[index];
+                stats.meshesOccluded++;
+                continue;
+            }
 
-                // Since we only need world normals we dont multiply projection
-                vec4& normal = mesh->transformed_normals[index] =
-                    parentMatrix * transform.get_matrix() * mesh->original_normals[index];
+            FrameStats::Clock::time_point start = FrameStats::Clock::now();
 
-                // Normalize vertex
-                float divisor = 1.f / vertex.w;
+            size_t lod_vertex_count = mesh->get_lod_vertex_count(state->lod);
+
+            state->display_vertices = arena.allocate< ivec4 >(lod_vertex_count);
+            state->computed_colors = arena.allocate< Color >(lod_vertex_count);
+
+            stats.verticesRendered += unsigned(lod_vertex_count);
+
+            // Clip codes and display vertices of every vertex, lighting waits for triangles to be classified
+            if (fused)
+            {
+                state->clip_codes = arena.allocate< uint16_t >(lod_vertex_count);
+
+                process_vertices(*mesh, *state, transformation, view);
 
-                vertex.x *= divisor;
-                vertex.y *= divisor;
-                vertex.z *= divisor;
-                vertex.w = 1.f;
+                // Clip space vertices never leave the block
+                stats.vertexBytesRead    += lod_vertex_count * 3 * sizeof(float);
+                stats.vertexBytesWritten += lod_vertex_count * (sizeof(uint16_t) + sizeof(ivec4));
 
-                // Normalize normal
-                vec3 normalizedNormal = normalize(vec3(normal.x, normal.y, normal.z));
-                normal = vec4(normalizedNormal.x, normalizedNormal.y, normalizedNormal.z, 0.f);
+                stats.add_time(FrameStats::VertexTransform, start);
+                start = FrameStats::Clock::now();
             }
-        }
-    }
 
-    // Give vector of lights
-    void Entity::render(mat4 transformation, View* view)
-    {
-        size_t meshes_number = meshes.size();
+            const uint16_t* codes = state->clip_codes;
 
-        // Iterate all meshes
-        for (int i = 0; i < meshes_number; i++)
-        {
-            Mesh* mesh = &meshes[i];
+            // Classify triangles first so only vertices of surviving ones are lit and transformed
+            const vector< int >& lod_indices = mesh->get_lod_indices(state->lod);
+
+            // Sized for the worst case, both only live until the end of the frame
+            int* visible_triangles   = arena.allocate< int >(lod_indices.size() / 3);
+            int* referenced_vertices = arena.allocate< int >(lod_vertex_count);
+
+            state->vertex_referenced = arena.allocate< uint8_t >(lod_vertex_count);
+            std::fill_n(state->vertex_referenced, lod_vertex_count, uint8_t(0));
 
-            size_t number_of_vertices = mesh->transformed_vertices.size();
+            stats.vertexBytesWritten += lod_vertex_count * sizeof(uint8_t);
 
-            // Transform every vertex of the mesh to view 
-            for (size_t index = 0; index < number_of_vertices; index++)
+            size_t visible_count = 0;
+            size_t referenced_count = 0;
+
+            for (const int* indices = lod_indices.data(), *end = indices + lod_indices.size(); indices < end; indices += 3)
             {
-                mesh->display_vertices[index] =
-                    ivec4(transformation * mesh->transformed_vertices[index]);
-
-				// Compute lightning needs: Vertex world position, light vector, normal world position, vertex color
-				mesh->computed_colors[index] = compute_lightning(mesh->original_colors[index],
-					get_parent_matrix() * transform.get_matrix() * mesh->original_vertices[index], // World vertex
-					mesh->transformed_normals[index], // World normals
-					view->get_lights());
+                // Every vertex outside the same plane
+                if (codes[indices[0]] & codes[indices[1]] & codes[indices[2]] & Clipper::RejectMask)
+                {
+                    stats.trianglesRejected++;
+                    continue;
+                }
+
+                bool backface;
+
+                if (not fused)
+                    backface = view->is_backface(state->transformed_vertices, indices);
+                else if ((codes[indices[0]] | codes[indices[1]] | codes[indices[2]]) & Clipper::ClipMask)
+                {
+                    // Display coordinates may be missing or out of range, clip space vertices are rebuilt instead
+                    vec4 triangle_vertices[3];
+
+                    for (int corner = 0; corner < 3; corner++)
+                        triangle_vertices[corner] = clipMatrix * mesh->get_position(indices[corner]);
+
+                    const static int triangle_indices[] = { 0, 1, 2 };
+
+                    backface = view->is_backface(triangle_vertices, triangle_indices);
+                }
+                else
+                    backface = view->is_backface(state->display_vertices, indices);
+
+                if (backface)
+                {
+                    stats.trianglesBackfacing++;
+                    continue;
+                }
+
+                visible_triangles[visible_count++] = int(indices - lod_indices.data());
+
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    int index = indices[corner];
+
+                    if (not state->vertex_referenced[index])
+                    {
+                        state->vertex_referenced[index] = 1;
+                        referenced_vertices[referenced_count++] = index;
+                    }
+                }
             }
 
-            // Create size pointers
-            int* indices = mesh->original_indices.data();
-            int* end = indices + mesh->original_indices.size();
+            stats.verticesSkipped += unsigned(lod_vertex_count - referenced_count);
+
+            stats.add_time(FrameStats::Clipping, start);
+            start = FrameStats::Clock::now();
+
+            if (fused)
+            {
+                light_vertices(*mesh, *state, normalMatrix, referenced_vertices, referenced_count, view);
+
+                stats.verticesLit += unsigned(referenced_count);
+
+                // Normals and, for point lights, positions of referenced vertices are gathered, world normals never leave the block
+                bool point_lights = view->get_light_table().has_point_lights();
+
+                stats.vertexBytesRead    += referenced_count * (sizeof(int) + sizeof(uint32_t) + (point_lights ? 3 * sizeof(float) : 0));
+                stats.vertexBytesWritten += referenced_count * (sizeof(int) + sizeof(Color));
+
+                stats.add_time(FrameStats::Lighting, start);
+                start = FrameStats::Clock::now();
+            }
+            else
+            {
+                // Transform referenced vertices to view, vertices behind near plane
+                // are only used through the clipper
+                for (size_t i = 0; i < referenced_count; i++)
+                {
+                    int index = referenced_vertices[i];
+
+                    if (codes[index] & Clipper::Near) continue;
+
+                    const vec4& vertex = state->transformed_vertices[index];
+
+                    float divisor = 1.f / vertex.w;
+
+                    ivec4& display = state->display_vertices[index];
+
+                    display = ivec4(transformation * vec4(vertex.x * divisor, vertex.y * divisor, vertex.z * divisor, 1.f));
+                    display.z = view->get_depth_key(vertex.z, vertex.w);
+                }
+
+                stats.add_time(FrameStats::VertexTransform, start);
+                start = FrameStats::Clock::now();
+
+                // Light table needs world normals and, for point lights, world positions
+                view->get_light_table().illuminate(*mesh, *state, worldMatrix, referenced_vertices, referenced_count, arena);
+
+                stats.verticesLit += unsigned(referenced_count);
+
+                // Referenced vertices are gathered twice, for display coordinates and for lighting
+                // with the light streams going through the arena
+                bool   point_lights = view->get_light_table().has_point_lights();
+                size_t light_streams = point_lights ? 9 : 6;
+
+                stats.vertexBytesRead    += referenced_count * (sizeof(vec4) + sizeof(vec4) + (point_lights ? 3 * sizeof(float) : 0) +
+                                                                light_streams * sizeof(float));
+                stats.vertexBytesWritten += referenced_count * (sizeof(int) + sizeof(ivec4) + light_streams * sizeof(float) + sizeof(Color));
+
+                stats.add_time(FrameStats::Lighting, start);
+                start = FrameStats::Clock::now();
+            }
+
+            // Time spent clipping is measured apart from rasterization
+            FrameStats::Clock::duration clipping_time = FrameStats::Clock::duration::zero();
 
-            vector< int > clip_indices;
             const float inverse255 = 1.f / 255.f;
 
-            for (; indices < end; indices += 3)
+            // Gouraud shading interpolates lit vertex colors instead of averaging them
+            bool smooth = view->get_shading_mode() == Rasterizer< View::Color_Buffer >::GOURAUD_SHADING;
+
+            const Color* vertex_colors = smooth ? state->computed_colors : nullptr;
+
+            for (size_t triangle = 0; triangle < visible_count; triangle++)
             {
-                // For some reason frontfaces are not really well calculated
-                if (not view->is_backface(mesh->transformed_vertices.data(), indices))
+                const int* indices = lod_indices.data() + visible_triangles[triangle];
+
+                unsigned code0 = codes[indices[0]];
+                unsigned code1 = codes[indices[1]];
+                unsigned code2 = codes[indices[2]];
+
+                if (not smooth)
                 {
                     // Set color with the mean of the three vertexes
                     vec3 polygonColor = vec3(0, 0, 0);
 
-                    bool inside = true;
-
                     for (auto index = indices; index < indices + 3; index++)
                     {
                         // Sum each vertex color
-                        polygonColor += vec3(mesh->computed_colors[*index].red() * inverse255,
-                            mesh->computed_colors[*index].green() * inverse255,
-                            mesh->computed_colors[*index].blue() * inverse255);
-
-                        // Clip vertices
-                        if (mesh->display_vertices[*index].x > (int)view->get_width() ||
-                            mesh->display_vertices[*index].x < 0 ||
-                            mesh->display_vertices[*index].y > (int)view->get_height() ||
-                            mesh->display_vertices[*index].y < 0)
-                            inside = false;
+                        polygonColor += vec3(state->computed_colors[*index].red() * inverse255,
+                            state->computed_colors[*index].green() * inverse255,
+                            state->computed_colors[*index].blue() * inverse255);
                     }
 
                     // Normalize polygon color
                     polygonColor = vec3(polygonColor.r / 3, polygonColor.g / 3, polygonColor.b / 3);
 
                     view->set_rasterizer_color(Color(polygonColor.r, polygonColor.g, polygonColor.b));
+                }
+
+                unsigned outside = code0 | code1 | code2;
+
+                // Inside guard band, rasterizer scissors it against the viewport
+                if (not (outside & Clipper::ClipMask))
+                {
+                    if (outside & Clipper::ViewportMask)
+                        stats.trianglesScissored++;
+                    else
+                        stats.trianglesInside++;
 
-                    if(inside)
-                        view->rasterizer_fill_polygon(mesh->display_vertices.data(), indices, indices + 3);
+                    if (smooth)
+                        view->rasterizer_fill_polygon(state->display_vertices, vertex_colors, indices, indices + 3);
                     else
+                        view->rasterizer_fill_polygon(state->display_vertices, indices, indices + 3);
+                }
+                else
+                {
+                    vec4  clipped_vertices[Clipper::max_vertices];
+                    ivec4 display_vertices[Clipper::max_vertices];
+                    vec3  clipped_colors[Clipper::max_vertices];
+                    Color display_colors[Clipper::max_vertices];
+                    const static int clipped_indices[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+
+                    FrameStats::Clock::time_point clip_start = FrameStats::Clock::now();
+
+                    // Clip a copy of the triangle so its colors can be indexed like its vertices,
+                    // the fused vertex stage does not keep clip space vertices so they are rebuilt
+                    vec4 triangle_vertices[3];
+
+                    for (int corner = 0; corner < 3; corner++)
                     {
-                        ivec4 clipped_vertices[10];
-                        const static int clipped_indices[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+                        triangle_vertices[corner] = fused ? clipMatrix * mesh->get_position(indices[corner])
+                                                          : state->transformed_vertices[indices[corner]];
+                    }
+
+                    int n;
+
+                    if (smooth)
+                    {
+                        vec3 triangle_colors[3];
+
+                        for (int corner = 0; corner < 3; corner++)
+                        {
+                            const Color& color = vertex_colors[indices[corner]];
 
-                        int n = Clipper::clip(mesh->display_vertices.data(), indices, indices + 3, clipped_vertices, view->get_width(), view->get_height());
+                            triangle_colors[corner] = vec3(color.red(), color.green(), color.blue()) * inverse255;
+                        }
 
-                        // If clipped vertices make a polygon then fill it
-                        if(n > 2)
-                            view->rasterizer_fill_polygon(clipped_vertices, clipped_indices, clipped_indices + n);                         
+                        n = Clipper::clip(triangle_vertices, triangle_colors, clipped_indices, clipped_indices + 3, outside, view->get_guard_band(), clipped_vertices, clipped_colors);
+
+                        for (int index = 0; index < n; index++)
+                            display_colors[index] = Color(clipped_colors[index].r, clipped_colors[index].g, clipped_colors[index].b);
+                    }
+                    else
+                        n = Clipper::clip(triangle_vertices, clipped_indices, clipped_indices + 3, outside, view->get_guard_band(), clipped_vertices);
+
+                    // Clipped vertices are in front of near plane so they can be divided
+                    for (int index = 0; index < n; index++)
+                    {
+                        const vec4& vertex = clipped_vertices[index];
+
+                        float divisor = 1.f / vertex.w;
+
+                        display_vertices[index] = ivec4(transformation * vec4(vertex.x * divisor, vertex.y * divisor, vertex.z * divisor, 1.f));
+                        display_vertices[index].z = view->get_depth_key(vertex.z, vertex.w);
+                    }
+
+                    clipping_time += FrameStats::Clock::now() - clip_start;
+
+                    stats.trianglesClipped++;
+
+                    // If clipped vertices make a polygon then fill it
+                    if (n > 2)
+                    {
+                        if (smooth)
+                            view->rasterizer_fill_polygon(display_vertices, display_colors, clipped_indices, clipped_indices + n);
+                        else
+                            view->rasterizer_fill_polygon(display_vertices, clipped_indices, clipped_indices + n);
                     }
                 }
             }
+
+            double clipping_ms = std::chrono::duration< double, std::milli >(clipping_time).count();
+
+            stats.add_time(FrameStats::Rasterization, start);
+            stats.stageTimes[FrameStats::Rasterization] -= clipping_ms;
+            stats.stageTimes[FrameStats::Clipping     ] += clipping_ms;
         }
     }
 
-    mat4 Entity::get_parent_matrix()
+    void Entity::update_world_matrix(const Entity* parent_entity, FrameStats& stats)
     {
-        // Apply parent and projection transformations
-        mat4 parentMatrix = mat4(1);
+        bool parentChanged = parent_entity != nullptr && parent_entity->worldVersion != parentVersion;
 
-        // Get parent matrix
-        if (parent != nullptr)
-        {
-            vector< mat4 > parentList;
-
-            Entity* parentIt = parent;
-
-            // Get vector of parents
-            while (parentIt != nullptr)
-            {
-                parentList.push_back(parentIt->get_transform()->get_matrix());
-                parentIt = parentIt->get_parent();
-            }
+        // First call always computes the matrix
+        if (not parentChanged && not transform.has_changed() && worldVersion > 0)
+            return;
 
-            // Iterate vector backwards multiplying the matrix
-            for (int i = (int)parentList.size() - 1; i >= 0; i--)
-            {
-                parentMatrix *= parentList[i];
-            }
+        if (parent_entity != nullptr)
+        {
+            worldMatrix = parent_entity->worldMatrix * transform.get_matrix();
+            parentVersion = parent_entity->worldVersion;
         }
+        else
+            worldMatrix = transform.get_matrix();
+
+        transform.clear_changed();
+        worldVersion++;
 
-        return parentMatrix;
+        stats.matricesRecomputed++;
     }
 
-    Entity::Color Entity::compute_lightning(const Color& vertexColor, const vec4& vertex, const vec4& normal, vector<Light*>& lights)
+    void Entity::process_vertices(const Mesh& mesh, MeshState& state, const mat4& viewport, View* view)
     {
-        const float inverse255 = 1.f / 255.f;
+        const size_t block_size = LightTable::block_size;
 
-        vec3 result = vec3(0, 0, 0);
+        // Intermediate results of a block, they never leave the cache
+        vec4 clip_vertices[block_size];
 
-        for (size_t i = 0; i < lights.size(); i++)
-        {
-            switch (lights[i]->get_type())
-            {
-                case Light::Ambient:
-                {
-                    // Get ambient light
-                    float ambientIntensity = lights[i]->get_intensity();
-                    Color ambientColor = lights[i]->get_color();
+        float guard_band = view->get_guard_band();
 
-                    vec3 ambientLight = vec3(ambientColor.red() * ambientIntensity * inverse255,
-                        ambientColor.green() * ambientIntensity * inverse255,
-                        ambientColor.blue() * ambientIntensity * inverse255);
+        // Viewport only scales and translates x and y, depth is replaced by the depth key
+        const float scale_x = viewport[0][0], offset_x = viewport[3][0];
+        const float scale_y = viewport[1][1], offset_y = viewport[3][1];
 
-                    result += vec3(ambientLight.r,
-                        ambientLight.g,
-                        ambientLight.b);
-                }
-                break;
+        size_t count = mesh.get_lod_vertex_count(state.lod);
 
-                case Light::Directional:
-                {
-                    // Get light
-                    DirectionalLight* dirLight = dynamic_cast<DirectionalLight*>(lights[i]);
+        for (size_t first = 0; first < count; first += block_size)
+        {
+            size_t block_count = std::min(block_size, count - first);
 
-                    float dirIntensity = dirLight->get_intensity();
-                    Color dirColor = dirLight->get_color();
+            VertexBatch::transform_positions(clipMatrix,
+                mesh.positions_x.data() + first, mesh.positions_y.data() + first, mesh.positions_z.data() + first,
+                block_count, clip_vertices);
 
-                    vec3 directionalLightColor = vec3(dirColor.red() * dirIntensity * inverse255,
-                        dirColor.green() * dirIntensity * inverse255,
-                        dirColor.blue() * dirIntensity * inverse255);
+            uint16_t* codes = state.clip_codes + first;
 
-					// Clamp this
-                    float diff = dot(vec3(normal.x, normal.y, normal.z), dirLight->get_direction());
+            Clipper::compute_codes(clip_vertices, block_count, guard_band, codes);
 
-                    diff = diff < 0 ? 0 : diff;
+            ivec4* display_vertices = state.display_vertices + first;
 
-                    vec3 diffuse = diff * directionalLightColor;
+            // Triangles with a vertex outside near, far or guard band planes are clipped from clip space vertices,
+            // so those vertices never need display coordinates
+            for (size_t i = 0; i < block_count; i++)
+            {
+                if (codes[i] & Clipper::ClipMask) continue;
 
-                    result += vec3(diffuse.r,
-                        diffuse.g,
-                        diffuse.b);
-                }
-                break;
+                const vec4& vertex = clip_vertices[i];
+
+                float divisor = 1.f / vertex.w;
 
-                default:
-                    break;
+                display_vertices[i] = ivec4(int(vertex.x * divisor * scale_x + offset_x),
+                                            int(vertex.y * divisor * scale_y + offset_y),
+                                            view->get_depth_key(vertex.z, vertex.w), 1);
             }
         }
-
-        return Color(result.r * vertexColor.red() * inverse255, result.g * vertexColor.green() * inverse255, result.b * vertexColor.blue() * inverse255);
     }
 
-    mat4 Entity::aiToGlm(const aiMatrix4x4& from)
+    void Entity::light_vertices(const Mesh& mesh, MeshState& state, const mat3& normal_matrix, const int* vertices, size_t count, View* view)
     {
-        glm::mat4 to;
-        to[0][0] = from.a1; to[0][1] = from.b1; to[0][2] = from.c1; to[0][3] = from.d1;
-        to[1][0] = from.a2; to[1][1] = from.b2; to[1][2] = from.c2; to[1][3] = from.d2;
-        to[2][0] = from.a3; to[2][1] = from.b3; to[2][2] = from.c3; to[2][3] = from.d3;
-        to[3][0] = from.a4; to[3][1] = from.b4; to[3][2] = from.c4; to[3][3] = from.d4;
-        return to;
+        const size_t block_size = LightTable::block_size;
+
+        // Gathered normals of a block and their world transform, they never leave the cache
+        uint32_t encoded_normals[block_size];
+        vec4     world_normals[block_size];
+
+        LightTable& lightTable = view->get_light_table();
+
+        for (size_t first = 0; first < count; first += block_size)
+        {
+            size_t block_count = std::min(block_size, count - first);
+
+            for (size_t i = 0; i < block_count; i++)
+                encoded_normals[i] = mesh.normals[vertices[first + i]];
+
+            VertexBatch::transform_normals(normal_matrix, encoded_normals, block_count, world_normals);
+
+            lightTable.illuminate_block(mesh, state, worldMatrix, world_normals, vertices + first, block_count);
+        }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,72 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include <algorithm>
+#include "FrameArena.h"
+
+namespace MGVisualizer
+{
+    FrameArena::FrameArena(size_t initial_capacity)
+        :
+        capacity(0),
+        used(0),
+        requested(0),
+        peak(0)
+    {
+        if (initial_capacity > 0)
+        {
+            // Spare alignment so the first allocation can be aligned
+            block.reset(new unsigned char[initial_capacity + alignment]);
+            capacity = initial_capacity;
+        }
+    }
+
+    void FrameArena::reset()
+    {
+        peak = std::max(peak, requested);
+
+        // Replace block with one holding the whole frame
+        if (not overflow.empty())
+        {
+            overflow.clear();
+
+            size_t new_capacity = std::max(peak + peak / 4, capacity * 2);
+
+            block.reset(new unsigned char[new_capacity + alignment]);
+            capacity = new_capacity;
+        }
+
+        used = 0;
+        requested = 0;
+    }
+
+    void* FrameArena::allocate_bytes(size_t size)
+    {
+        size = (std::max< size_t >(size, 1) + alignment - 1) & ~(alignment - 1);
+
+        requested += size;
+
+        unsigned char* base = block.get();
+
+        if (base != nullptr)
+        {
+            size_t offset = (alignment - reinterpret_cast< size_t >(base) % alignment) % alignment;
+
+            if (offset + used + size <= capacity + alignment)
+            {
+                void* memory = base + offset + used;
+                used += size;
+                return memory;
+            }
+        }
+
+        // Does not fit, kept apart until reset makes the block large enough
+        overflow.emplace_back(new unsigned char[size + alignment]);
+
+        unsigned char* memory = overflow.back().get();
+
+        return memory + (alignment - reinterpret_cast< size_t >(memory) % alignment) % alignment;
+    }
+}
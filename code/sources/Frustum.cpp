@@ -0,0 +1,61 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include "Frustum.h"
+
+namespace MGVisualizer
+{
+    Frustum::Frustum(const mat4& matrix)
+    {
+        // glm matrices are stored by columns, rows are gathered to combine them
+        vec4 row0(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+        vec4 row1(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+        vec4 row2(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+        vec4 row3(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+
+        // -w <= x, y, z <= w in clip space
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+
+        // Normalized planes give real distances for the sphere test
+        for (vec4& plane : planes)
+        {
+            float length = glm::length(vec3(plane));
+
+            if (length > 0.f) plane /= length;
+        }
+    }
+
+    bool Frustum::intersects_sphere(const vec3& center, float radius) const
+    {
+        for (const vec4& plane : planes)
+        {
+            if (dot(vec3(plane), center) + plane.w < -radius)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool Frustum::intersects_box(const vec3& min_corner, const vec3& max_corner) const
+    {
+        for (const vec4& plane : planes)
+        {
+            // Corner furthest along plane normal
+            vec3 corner(plane.x >= 0.f ? max_corner.x : min_corner.x,
+                        plane.y >= 0.f ? max_corner.y : min_corner.y,
+                        plane.z >= 0.f ? max_corner.z : min_corner.z);
+
+            if (dot(vec3(plane), corner) + plane.w < 0.f)
+                return false;
+        }
+
+        return true;
+    }
+}
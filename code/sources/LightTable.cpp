@@ -0,0 +1,272 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include "LightTable.h"
+#include "DirectionalLight.h"
+#include "PointLight.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+    #define MG_LIGHT_SSE 1
+    #include <xmmintrin.h>
+#endif
+
+namespace MGVisualizer
+{
+    void LightTable::compile(const vector< Light* >& lights)
+    {
+        const float inverse255 = 1.f / 255.f;
+
+        ambient = vec3(0.f);
+        directionals.clear();
+        points.clear();
+
+        for (Light* light : lights)
+        {
+            Rgb888 lightColor = light->get_color();
+            float  intensity  = light->get_intensity();
+
+            vec3 color = vec3(lightColor.red() * intensity * inverse255,
+                lightColor.green() * intensity * inverse255,
+                lightColor.blue() * intensity * inverse255);
+
+            // Type tells the class, no cast has to be checked
+            switch (light->get_type())
+            {
+                case Light::Ambient:
+                    ambient += color;
+                    break;
+
+                case Light::Directional:
+                    // Directional lights keep their direction normalized
+                    directionals.push_back({ static_cast< DirectionalLight* >(light)->get_direction(), color });
+                    break;
+
+                case Light::Point:
+                {
+                    PointLight* pointLight = static_cast< PointLight* >(light);
+
+                    float range = std::max(pointLight->get_range(), 1e-6f);
+
+                    points.push_back({ pointLight->get_position(), color, 1.f / (range * range) });
+                }
+                break;
+            }
+        }
+    }
+
+    void LightTable::illuminate(const Mesh& mesh, MeshState& state, const mat4& world_matrix, const int* vertices, size_t count, FrameArena& arena)
+    {
+        const float inverse255 = 1.f / 255.f;
+
+        for (float** stream : { &normals_x, &normals_y, &normals_z, &red, &green, &blue })
+            *stream = arena.allocate< float >(count);
+
+        if (not points.empty())
+        {
+            for (float** stream : { &positions_x, &positions_y, &positions_z })
+                *stream = arena.allocate< float >(count);
+        }
+
+        // Gather vertices of visible triangles, positions are only needed by point lights
+        for (size_t i = 0; i < count; i++)
+        {
+            const vec4& normal = state.transformed_normals[vertices[i]];
+
+            normals_x[i] = normal.x;
+            normals_y[i] = normal.y;
+            normals_z[i] = normal.z;
+
+            red[i]   = ambient.r;
+            green[i] = ambient.g;
+            blue[i]  = ambient.b;
+        }
+
+        if (not points.empty())
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                vec4 position = world_matrix * mesh.get_position(vertices[i]);
+
+                positions_x[i] = position.x;
+                positions_y[i] = position.y;
+                positions_z[i] = position.z;
+            }
+        }
+
+        add_lights(count);
+
+        // Modulate vertex color with the light reaching it
+        for (size_t i = 0; i < count; i++)
+        {
+            int index = vertices[i];
+
+            const Rgb888& vertexColor = mesh.material_color;
+
+            state.computed_colors[index] = Rgb888(red[i] * vertexColor.red() * inverse255,
+                green[i] * vertexColor.green() * inverse255,
+                blue[i] * vertexColor.blue() * inverse255);
+        }
+    }
+
+    void LightTable::illuminate_block(const Mesh& mesh, MeshState& state, const mat4& world_matrix, const vec4* normals, const int* vertices, size_t count)
+    {
+        assert(count <= block_size);
+
+        const float inverse255 = 1.f / 255.f;
+
+        float** streams[] = { &positions_x, &positions_y, &positions_z, &normals_x, &normals_y, &normals_z, &red, &green, &blue };
+
+        for (int stream = 0; stream < 9; stream++)
+            *streams[stream] = block[stream];
+
+        for (size_t i = 0; i < count; i++)
+        {
+            normals_x[i] = normals[i].x;
+            normals_y[i] = normals[i].y;
+            normals_z[i] = normals[i].z;
+
+            red[i]   = ambient.r;
+            green[i] = ambient.g;
+            blue[i]  = ambient.b;
+        }
+
+        if (not points.empty())
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                vec4 position = world_matrix * mesh.get_position(vertices[i]);
+
+                positions_x[i] = position.x;
+                positions_y[i] = position.y;
+                positions_z[i] = position.z;
+            }
+        }
+
+        add_lights(count);
+
+        const Rgb888& vertexColor = mesh.material_color;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            state.computed_colors[vertices[i]] = Rgb888(red[i] * vertexColor.red() * inverse255,
+                green[i] * vertexColor.green() * inverse255,
+                blue[i] * vertexColor.blue() * inverse255);
+        }
+    }
+
+    void LightTable::add_lights(size_t count)
+    {
+        for (const Directional& light : directionals)
+            add_directional(light, count);
+
+        for (const Point& light : points)
+            add_point(light, count);
+    }
+
+    void LightTable::add_directional(const Directional& light, size_t count)
+    {
+        size_t i = 0;
+
+    #ifdef MG_LIGHT_SSE
+
+        const __m128 dx = _mm_set1_ps(light.direction.x);
+        const __m128 dy = _mm_set1_ps(light.direction.y);
+        const __m128 dz = _mm_set1_ps(light.direction.z);
+        const __m128 cr = _mm_set1_ps(light.color.r);
+        const __m128 cg = _mm_set1_ps(light.color.g);
+        const __m128 cb = _mm_set1_ps(light.color.b);
+        const __m128 zero = _mm_setzero_ps();
+
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 diffuse = _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(_mm_loadu_ps(&normals_x[i]), dx),
+                _mm_mul_ps(_mm_loadu_ps(&normals_y[i]), dy)),
+                _mm_mul_ps(_mm_loadu_ps(&normals_z[i]), dz));
+
+            diffuse = _mm_max_ps(diffuse, zero);
+
+            _mm_storeu_ps(&red[i],   _mm_add_ps(_mm_loadu_ps(&red[i]),   _mm_mul_ps(diffuse, cr)));
+            _mm_storeu_ps(&green[i], _mm_add_ps(_mm_loadu_ps(&green[i]), _mm_mul_ps(diffuse, cg)));
+            _mm_storeu_ps(&blue[i],  _mm_add_ps(_mm_loadu_ps(&blue[i]),  _mm_mul_ps(diffuse, cb)));
+        }
+
+    #endif
+
+        for (; i < count; i++)
+        {
+            float diffuse = normals_x[i] * light.direction.x + normals_y[i] * light.direction.y + normals_z[i] * light.direction.z;
+
+            diffuse = diffuse < 0.f ? 0.f : diffuse;
+
+            red[i]   += diffuse * light.color.r;
+            green[i] += diffuse * light.color.g;
+            blue[i]  += diffuse * light.color.b;
+        }
+    }
+
+    void LightTable::add_point(const Point& light, size_t count)
+    {
+        size_t i = 0;
+
+    #ifdef MG_LIGHT_SSE
+
+        const __m128 lx = _mm_set1_ps(light.position.x);
+        const __m128 ly = _mm_set1_ps(light.position.y);
+        const __m128 lz = _mm_set1_ps(light.position.z);
+        const __m128 cr = _mm_set1_ps(light.color.r);
+        const __m128 cg = _mm_set1_ps(light.color.g);
+        const __m128 cb = _mm_set1_ps(light.color.b);
+        const __m128 inverse_range2 = _mm_set1_ps(light.inverse_range2);
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 epsilon = _mm_set1_ps(1e-12f);
+
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 tx = _mm_sub_ps(lx, _mm_loadu_ps(&positions_x[i]));
+            __m128 ty = _mm_sub_ps(ly, _mm_loadu_ps(&positions_y[i]));
+            __m128 tz = _mm_sub_ps(lz, _mm_loadu_ps(&positions_z[i]));
+
+            __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz));
+
+            __m128 diffuse = _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(_mm_loadu_ps(&normals_x[i]), tx),
+                _mm_mul_ps(_mm_loadu_ps(&normals_y[i]), ty)),
+                _mm_mul_ps(_mm_loadu_ps(&normals_z[i]), tz));
+
+            // Normalize direction to the light and attenuate with distance
+            diffuse = _mm_div_ps(_mm_max_ps(diffuse, zero), _mm_sqrt_ps(_mm_max_ps(distance2, epsilon)));
+            diffuse = _mm_div_ps(diffuse, _mm_add_ps(one, _mm_mul_ps(distance2, inverse_range2)));
+
+            _mm_storeu_ps(&red[i],   _mm_add_ps(_mm_loadu_ps(&red[i]),   _mm_mul_ps(diffuse, cr)));
+            _mm_storeu_ps(&green[i], _mm_add_ps(_mm_loadu_ps(&green[i]), _mm_mul_ps(diffuse, cg)));
+            _mm_storeu_ps(&blue[i],  _mm_add_ps(_mm_loadu_ps(&blue[i]),  _mm_mul_ps(diffuse, cb)));
+        }
+
+    #endif
+
+        for (; i < count; i++)
+        {
+            float tx = light.position.x - positions_x[i];
+            float ty = light.position.y - positions_y[i];
+            float tz = light.position.z - positions_z[i];
+
+            float distance2 = tx * tx + ty * ty + tz * tz;
+
+            float diffuse = normals_x[i] * tx + normals_y[i] * ty + normals_z[i] * tz;
+
+            diffuse = (diffuse < 0.f ? 0.f : diffuse) / std::sqrt(std::max(distance2, 1e-12f));
+            diffuse = diffuse / (1.f + distance2 * light.inverse_range2);
+
+            red[i]   += diffuse * light.color.r;
+            green[i] += diffuse * light.color.g;
+            blue[i]  += diffuse * light.color.b;
+        }
+    }
+}
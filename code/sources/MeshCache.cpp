@@ -0,0 +1,370 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "MeshCache.h"
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace MGVisualizer
+{
+    namespace
+    {
+        // File layout: Header, model path, then for each mesh a MeshHeader followed by
+        // positions x/y/z as float streams, octahedral normals as uint32 stream and indices as int32 stream, then a
+        // LodHeader and indices for each level of detail. Every block is padded to 4 bytes.
+        // Streams are stored already optimized for the vertex cache.
+
+        const char     cacheMagic[4] = { 'M', 'G', 'M', 'C' };
+        const uint32_t cacheVersion  = 4;
+
+        struct Header
+        {
+            char     magic[4];
+            uint32_t version;
+            uint64_t sourceTime;
+            uint64_t sourceSize;
+            uint32_t importFlags;
+            uint32_t meshCount;
+            uint32_t pathLength;
+            uint32_t padding;
+        };
+
+        struct MeshHeader
+        {
+            uint32_t vertexCount;
+            uint32_t indexCount;
+            uint8_t  diffuse[4];
+            float    importedAcmr;
+            uint32_t lodCount;
+        };
+
+        struct LodHeader
+        {
+            uint32_t vertexCount;
+            uint32_t indexCount;
+        };
+
+        struct SourceStamp
+        {
+            uint64_t time;
+            uint64_t size;
+        };
+
+        bool get_source_stamp(const char* model_path, SourceStamp& stamp)
+        {
+            std::error_code error;
+
+            auto time = std::filesystem::last_write_time(model_path, error);
+            if (error) return false;
+
+            auto size = std::filesystem::file_size(model_path, error);
+            if (error) return false;
+
+            stamp.time = uint64_t(time.time_since_epoch().count());
+            stamp.size = uint64_t(size);
+
+            return true;
+        }
+
+        size_t padded(size_t size)
+        {
+            return (size + 3) & ~size_t(3);
+        }
+
+        /// <summary>
+        /// Read only view of a whole file mapped in memory
+        /// </summary>
+        class MappedFile
+        {
+        private:
+
+            const unsigned char* data;
+            size_t size;
+
+        #ifdef _WIN32
+            HANDLE file;
+            HANDLE mapping;
+        #endif
+
+        public:
+
+            MappedFile(const char* path) : data(nullptr), size(0)
+            {
+            #ifdef _WIN32
+                mapping = nullptr;
+                file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (file == INVALID_HANDLE_VALUE) return;
+
+                LARGE_INTEGER file_size;
+                if (not GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) return;
+
+                mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping == nullptr) return;
+
+                data = static_cast< const unsigned char* >(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                if (data != nullptr) size = size_t(file_size.QuadPart);
+            #else
+                int descriptor = open(path, O_RDONLY);
+                if (descriptor < 0) return;
+
+                struct stat status;
+
+                if (fstat(descriptor, &status) == 0 && status.st_size > 0)
+                {
+                    void* view = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+                    if (view != MAP_FAILED)
+                    {
+                        data = static_cast< const unsigned char* >(view);
+                        size = size_t(status.st_size);
+                    }
+                }
+
+                // Mapping stays valid after closing the descriptor
+                close(descriptor);
+            #endif
+            }
+
+            ~MappedFile()
+            {
+            #ifdef _WIN32
+                if (data != nullptr) UnmapViewOfFile(data);
+                if (mapping != nullptr) CloseHandle(mapping);
+                if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+            #else
+                if (data != nullptr) munmap(const_cast< unsigned char* >(data), size);
+            #endif
+            }
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator = (const MappedFile&) = delete;
+
+            const unsigned char* get_data() const { return data; }
+            size_t get_size() const { return size; }
+        };
+
+        /// <summary>
+        /// Bounds checked cursor over mapped bytes
+        /// </summary>
+        class Reader
+        {
+        private:
+
+            const unsigned char* cursor;
+            const unsigned char* end;
+
+        public:
+
+            Reader(const unsigned char* data, size_t size) : cursor(data), end(data + size) { }
+
+            bool read(void* destination, size_t size)
+            {
+                if (size_t(end - cursor) < padded(size)) return false;
+
+                if (size > 0) std::memcpy(destination, cursor, size);
+                cursor += padded(size);
+
+                return true;
+            }
+
+            size_t remaining() const { return size_t(end - cursor); }
+        };
+
+        // Corrupt indices would be followed by out of bounds reads in every vertex loop
+        bool indices_below(const vector< int >& indices, size_t vertex_count)
+        {
+            for (int index : indices)
+            {
+                if (index < 0 || size_t(index) >= vertex_count) return false;
+            }
+
+            return true;
+        }
+
+        void write_block(std::ofstream& file, const void* data, size_t size)
+        {
+            static const char zeros[4] = { };
+
+            file.write(static_cast< const char* >(data), std::streamsize(size));
+            file.write(zeros, std::streamsize(padded(size) - size));
+        }
+    }
+
+    std::string MeshCache::get_cache_path(const char* model_path)
+    {
+        return std::string(model_path) + ".mgcache";
+    }
+
+    bool MeshCache::load(const char* model_path, unsigned import_flags, vector< Mesh >& meshes)
+    {
+        SourceStamp stamp;
+        if (not get_source_stamp(model_path, stamp)) return false;
+
+        MappedFile file(get_cache_path(model_path).c_str());
+        if (file.get_data() == nullptr) return false;
+
+        Reader reader(file.get_data(), file.get_size());
+
+        // Cache is only valid for the same file contents, path and import flags
+        Header header;
+
+        if (not reader.read(&header, sizeof(header))) return false;
+
+        if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+            header.version     != cacheVersion ||
+            header.sourceTime  != stamp.time   ||
+            header.sourceSize  != stamp.size   ||
+            header.importFlags != import_flags ||
+            header.pathLength  != std::strlen(model_path))
+            return false;
+
+        std::string path(header.pathLength, '\0');
+
+        if (not reader.read(&path[0], header.pathLength) || path != model_path) return false;
+
+        // Counts are checked against the bytes left before allocating anything for them
+        if (uint64_t(header.meshCount) * sizeof(MeshHeader) > reader.remaining()) return false;
+
+        vector< Mesh > loaded(header.meshCount);
+
+        for (Mesh& mesh : loaded)
+        {
+            MeshHeader meshHeader;
+
+            if (not reader.read(&meshHeader, sizeof(meshHeader))) return false;
+
+            uint64_t streamsSize = uint64_t(meshHeader.vertexCount) * (3 * sizeof(float) + sizeof(uint32_t)) +
+                                   uint64_t(meshHeader.indexCount) * sizeof(int32_t);
+
+            if (streamsSize > reader.remaining()) return false;
+
+            mesh.resize(meshHeader.vertexCount, meshHeader.indexCount);
+
+            size_t streamSize = meshHeader.vertexCount * sizeof(float);
+
+            // Streams are copied as they are, no per vertex parsing
+            if (not reader.read(mesh.positions_x.data(), streamSize) ||
+                not reader.read(mesh.positions_y.data(), streamSize) ||
+                not reader.read(mesh.positions_z.data(), streamSize) ||
+                not reader.read(mesh.normals.data(), meshHeader.vertexCount * sizeof(uint32_t)) ||
+                not reader.read(mesh.original_indices.data(), meshHeader.indexCount * sizeof(int32_t)) ||
+                not indices_below(mesh.original_indices, meshHeader.vertexCount))
+                return false;
+
+            mesh.material_color.red() = meshHeader.diffuse[0];
+            mesh.material_color.green() = meshHeader.diffuse[1];
+            mesh.material_color.blue() = meshHeader.diffuse[2];
+
+            mesh.imported_acmr = meshHeader.importedAcmr;
+
+            if (uint64_t(meshHeader.lodCount) * sizeof(LodHeader) > reader.remaining()) return false;
+
+            mesh.lods.resize(meshHeader.lodCount);
+
+            for (Mesh::Lod& lod : mesh.lods)
+            {
+                LodHeader lodHeader;
+
+                if (not reader.read(&lodHeader, sizeof(lodHeader)) || lodHeader.vertexCount > meshHeader.vertexCount) return false;
+
+                if (uint64_t(lodHeader.indexCount) * sizeof(int32_t) > reader.remaining()) return false;
+
+                lod.vertex_count = lodHeader.vertexCount;
+                lod.indices.resize(lodHeader.indexCount);
+
+                // Levels only use their first vertices, so indices are checked against the level count
+                if (not reader.read(lod.indices.data(), lodHeader.indexCount * sizeof(int32_t)) ||
+                    not indices_below(lod.indices, lod.vertex_count))
+                    return false;
+            }
+
+            mesh.compute_bounds();
+        }
+
+        meshes.reserve(meshes.size() + loaded.size());
+
+        for (Mesh& mesh : loaded)
+            meshes.push_back(std::move(mesh));
+
+        return true;
+    }
+
+    bool MeshCache::save(const char* model_path, unsigned import_flags, const vector< Mesh >& meshes)
+    {
+        SourceStamp stamp;
+        if (not get_source_stamp(model_path, stamp)) return false;
+
+        // Write to a temporary file so a half written cache is never loaded
+        std::string cachePath = get_cache_path(model_path);
+        std::string temporaryPath = cachePath + ".tmp";
+
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (not file) return false;
+
+            Header header = { };
+            std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+            header.version = cacheVersion;
+            header.sourceTime = stamp.time;
+            header.sourceSize = stamp.size;
+            header.importFlags = import_flags;
+            header.meshCount = uint32_t(meshes.size());
+            header.pathLength = uint32_t(std::strlen(model_path));
+
+            write_block(file, &header, sizeof(header));
+            write_block(file, model_path, header.pathLength);
+
+            for (const Mesh& mesh : meshes)
+            {
+                MeshHeader meshHeader = { };
+                meshHeader.vertexCount = uint32_t(mesh.get_vertex_count());
+                meshHeader.indexCount = uint32_t(mesh.original_indices.size());
+                meshHeader.importedAcmr = mesh.imported_acmr;
+                meshHeader.lodCount = uint32_t(mesh.lods.size());
+
+                meshHeader.diffuse[0] = mesh.material_color.red();
+                meshHeader.diffuse[1] = mesh.material_color.green();
+                meshHeader.diffuse[2] = mesh.material_color.blue();
+
+                size_t streamSize = mesh.get_vertex_count() * sizeof(float);
+
+                write_block(file, &meshHeader, sizeof(meshHeader));
+                write_block(file, mesh.positions_x.data(), streamSize);
+                write_block(file, mesh.positions_y.data(), streamSize);
+                write_block(file, mesh.positions_z.data(), streamSize);
+                write_block(file, mesh.normals.data(), mesh.get_vertex_count() * sizeof(uint32_t));
+                write_block(file, mesh.original_indices.data(), mesh.original_indices.size() * sizeof(int32_t));
+
+                for (const Mesh::Lod& lod : mesh.lods)
+                {
+                    LodHeader lodHeader = { lod.vertex_count, uint32_t(lod.indices.size()) };
+
+                    write_block(file, &lodHeader, sizeof(lodHeader));
+                    write_block(file, lod.indices.data(), lod.indices.size() * sizeof(int32_t));
+                }
+            }
+
+            if (not file) return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, cachePath, error);
+
+        return not error;
+    }
+}
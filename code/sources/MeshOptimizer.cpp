@@ -0,0 +1,188 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include "MeshOptimizer.h"
+
+namespace MGVisualizer
+{
+    void MeshOptimizer::optimize_vertex_cache(vector< int >& indices, size_t vertex_count)
+    {
+        size_t triangle_count = indices.size() / 3;
+
+        if (triangle_count == 0 || vertex_count == 0) return;
+
+        // Triangles using each vertex, packed by vertex
+        vector< int > live(vertex_count, 0);
+
+        for (int index : indices)
+            live[index]++;
+
+        vector< int > offsets(vertex_count + 1, 0);
+
+        for (size_t vertex = 0; vertex < vertex_count; vertex++)
+            offsets[vertex + 1] = offsets[vertex] + live[vertex];
+
+        vector< int > adjacency(indices.size());
+        vector< int > filled(offsets.begin(), offsets.end() - 1);
+
+        for (size_t triangle = 0; triangle < triangle_count; triangle++)
+        {
+            for (int corner = 0; corner < 3; corner++)
+                adjacency[filled[indices[triangle * 3 + corner]]++] = int(triangle);
+        }
+
+        const int k = int(cache_size);
+
+        vector< int >  cache_time(vertex_count, 0);
+        vector< bool > emitted(triangle_count, false);
+        vector< int >  dead_end;
+        vector< int >  candidates;
+        vector< int >  output;
+
+        output.reserve(indices.size());
+        dead_end.reserve(indices.size());
+
+        int    time = k + 1;
+        size_t cursor = 0;
+        int    fanning = 0;
+
+        while (fanning >= 0)
+        {
+            candidates.clear();
+
+            // Emit every pending triangle around fanning vertex
+            for (int slot = offsets[fanning]; slot < offsets[fanning + 1]; slot++)
+            {
+                int triangle = adjacency[slot];
+
+                if (emitted[triangle]) continue;
+
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    int vertex = indices[triangle * 3 + corner];
+
+                    output.push_back(vertex);
+                    dead_end.push_back(vertex);
+                    candidates.push_back(vertex);
+
+                    live[vertex]--;
+
+                    // Vertex was evicted, it enters the cache again
+                    if (time - cache_time[vertex] > k)
+                        cache_time[vertex] = time++;
+                }
+
+                emitted[triangle] = true;
+            }
+
+            // Next fanning vertex is the one staying longest in cache that still has triangles
+            int best = -1;
+            int best_priority = -1;
+
+            for (int vertex : candidates)
+            {
+                if (live[vertex] <= 0) continue;
+
+                int priority = 0;
+
+                if (time - cache_time[vertex] + 2 * live[vertex] <= k)
+                    priority = time - cache_time[vertex];
+
+                if (priority > best_priority)
+                {
+                    best = vertex;
+                    best_priority = priority;
+                }
+            }
+
+            // Dead end, go back to recently used vertices, then to any vertex left
+            while (best < 0 && not dead_end.empty())
+            {
+                int vertex = dead_end.back();
+                dead_end.pop_back();
+
+                if (live[vertex] > 0) best = vertex;
+            }
+
+            while (best < 0 && cursor < vertex_count)
+            {
+                if (live[cursor] > 0) best = int(cursor);
+
+                cursor++;
+            }
+
+            fanning = best;
+        }
+
+        indices.swap(output);
+    }
+
+    void MeshOptimizer::optimize_vertex_fetch(Mesh& mesh)
+    {
+        size_t vertex_count = mesh.get_vertex_count();
+
+        vector< int > remap(vertex_count, -1);
+        int next = 0;
+
+        // Coarsest level first so every level only needs the first vertices
+        for (size_t level = mesh.lods.size() + 1; level-- > 0; )
+        {
+            vector< int >& indices = level == 0 ? mesh.original_indices : mesh.lods[level - 1].indices;
+
+            for (int& index : indices)
+            {
+                if (remap[index] < 0) remap[index] = next++;
+
+                index = remap[index];
+            }
+
+            if (level > 0) mesh.lods[level - 1].vertex_count = uint32_t(next);
+        }
+
+        for (int& target : remap)
+        {
+            if (target < 0) target = next++;
+        }
+
+        // Move every model stream to its new order
+        auto reorder = [&remap](auto& stream)
+        {
+            auto reordered = stream;
+
+            for (size_t vertex = 0; vertex < remap.size(); vertex++)
+                reordered[remap[vertex]] = stream[vertex];
+
+            stream.swap(reordered);
+        };
+
+        reorder(mesh.positions_x);
+        reorder(mesh.positions_y);
+        reorder(mesh.positions_z);
+        reorder(mesh.normals);
+    }
+
+    float MeshOptimizer::compute_acmr(const int* indices, size_t index_count, size_t vertex_count)
+    {
+        if (index_count < 3) return 0.f;
+
+        // Time each vertex entered the FIFO, it is cached while fewer than cache_size entered after it
+        vector< size_t > entered(vertex_count, 0);
+
+        size_t misses = 0;
+
+        for (size_t i = 0; i < index_count; i++)
+        {
+            size_t& time = entered[indices[i]];
+
+            if (time == 0 || misses + 1 - time > cache_size)
+            {
+                misses++;
+                time = misses;
+            }
+        }
+
+        return float(misses) / float(index_count / 3);
+    }
+}
@@ -0,0 +1,306 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <tuple>
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+namespace MGVisualizer
+{
+    namespace
+    {
+        /// <summary>
+        /// Symmetric 4x4 matrix adding squared distances to planes
+        /// </summary>
+        struct Quadric
+        {
+            double a00, a01, a02, a03;
+            double      a11, a12, a13;
+            double           a22, a23;
+            double                a33;
+
+            void add_plane(double x, double y, double z, double d, double weight)
+            {
+                a00 += weight * x * x; a01 += weight * x * y; a02 += weight * x * z; a03 += weight * x * d;
+                a11 += weight * y * y; a12 += weight * y * z; a13 += weight * y * d;
+                a22 += weight * z * z; a23 += weight * z * d;
+                a33 += weight * d * d;
+            }
+
+            void add(const Quadric& other)
+            {
+                a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+                a11 += other.a11; a12 += other.a12; a13 += other.a13;
+                a22 += other.a22; a23 += other.a23;
+                a33 += other.a33;
+            }
+
+            double error(const vec3& p) const
+            {
+                double x = p.x, y = p.y, z = p.z;
+
+                return x * x * a00 + 2 * x * y * a01 + 2 * x * z * a02 + 2 * x * a03
+                     + y * y * a11 + 2 * y * z * a12 + 2 * y * a13
+                     + z * z * a22 + 2 * z * a23
+                     + a33;
+            }
+        };
+
+        struct Collapse
+        {
+            double cost;
+            int    from;
+            int    to;
+        };
+
+        /// <summary>
+        /// Vertices sharing position with another vertex, where normals split
+        /// </summary>
+        vector< uint8_t > find_seams(const Mesh& mesh)
+        {
+            size_t vertex_count = mesh.get_vertex_count();
+
+            vector< int > order(vertex_count);
+            std::iota(order.begin(), order.end(), 0);
+
+            auto position = [&mesh](int vertex)
+            {
+                return std::make_tuple(mesh.positions_x[vertex], mesh.positions_y[vertex], mesh.positions_z[vertex]);
+            };
+
+            std::sort(order.begin(), order.end(), [&](int a, int b) { return position(a) < position(b); });
+
+            vector< uint8_t > seam(vertex_count, 0);
+
+            for (size_t i = 1; i < vertex_count; i++)
+            {
+                if (position(order[i]) == position(order[i - 1]))
+                    seam[order[i]] = seam[order[i - 1]] = 1;
+            }
+
+            return seam;
+        }
+    }
+
+    vector< int > MeshSimplifier::simplify(const Mesh& mesh, const vector< int >& indices, size_t target_triangles)
+    {
+        size_t vertex_count = mesh.get_vertex_count();
+
+        auto position = [&mesh](int vertex)
+        {
+            return vec3(mesh.positions_x[vertex], mesh.positions_y[vertex], mesh.positions_z[vertex]);
+        };
+
+        vector< int > current = indices;
+
+        // Area weighted planes of the triangles around each vertex
+        vector< Quadric > quadrics(vertex_count, Quadric());
+
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+            vec3 p0 = position(current[i]), p1 = position(current[i + 1]), p2 = position(current[i + 2]);
+            vec3 normal = cross(p1 - p0, p2 - p0);
+
+            float length = glm::length(normal);
+            if (length <= 0.f) continue;
+
+            normal /= length;
+
+            double d = -double(dot(normal, p0));
+
+            for (int corner = 0; corner < 3; corner++)
+                quadrics[current[i + corner]].add_plane(normal.x, normal.y, normal.z, d, length * 0.5);
+        }
+
+        vector< uint8_t > locked = find_seams(mesh);
+        vector< uint8_t > touched(vertex_count);
+        vector< int >     remap(vertex_count);
+        vector< int >     offsets(vertex_count + 1);
+        vector< int >     adjacency;
+        vector< Collapse > collapses;
+
+        vector< std::pair< int, int > > neighbours;
+
+        // Each pass collapses independent edges, cheapest first
+        for (int pass = 0; pass < 32 && current.size() / 3 > target_triangles; pass++)
+        {
+            size_t triangle_count = current.size() / 3;
+
+            // Triangles around each vertex
+            std::fill(offsets.begin(), offsets.end(), 0);
+
+            for (int index : current)
+                offsets[index + 1]++;
+
+            for (size_t vertex = 0; vertex < vertex_count; vertex++)
+                offsets[vertex + 1] += offsets[vertex];
+
+            adjacency.resize(current.size());
+
+            vector< int > filled(offsets.begin(), offsets.end() - 1);
+
+            for (size_t i = 0; i < current.size(); i++)
+                adjacency[filled[current[i]]++] = int(i / 3);
+
+            // Vertices on open borders or non manifold edges keep the silhouette
+            vector< uint8_t > fixed = locked;
+
+            for (size_t vertex = 0; vertex < vertex_count; vertex++)
+            {
+                if (fixed[vertex]) continue;
+
+                // Interior edges are shared by two triangles around the vertex
+                neighbours.clear();
+
+                for (int slot = offsets[vertex]; slot < offsets[vertex + 1]; slot++)
+                {
+                    const int* triangle = &current[adjacency[slot] * 3];
+
+                    for (int corner = 0; corner < 3; corner++)
+                    {
+                        int other = triangle[corner];
+                        if (other == int(vertex)) continue;
+
+                        auto found = std::find_if(neighbours.begin(), neighbours.end(), [other](const auto& n) { return n.first == other; });
+
+                        if (found == neighbours.end()) neighbours.push_back({ other, 1 });
+                        else found->second++;
+                    }
+                }
+
+                for (const auto& neighbour : neighbours)
+                {
+                    if (neighbour.second != 2) fixed[vertex] = 1;
+                }
+            }
+
+            collapses.clear();
+
+            for (size_t i = 0; i < current.size(); i += 3)
+            {
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    int a = current[i + corner];
+                    int b = current[i + (corner + 1) % 3];
+
+                    // Every interior edge is seen from both triangles, keep one
+                    if (a > b) continue;
+
+                    Quadric sum = quadrics[a];
+                    sum.add(quadrics[b]);
+
+                    if (not fixed[a]) collapses.push_back({ sum.error(position(b)), a, b });
+                    if (not fixed[b]) collapses.push_back({ sum.error(position(a)), b, a });
+                }
+            }
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+            std::iota(remap.begin(), remap.end(), 0);
+            std::fill(touched.begin(), touched.end(), 0);
+
+            size_t needed = triangle_count - target_triangles;
+            size_t removed = 0;
+
+            for (const Collapse& collapse : collapses)
+            {
+                if (touched[collapse.from] || touched[collapse.to]) continue;
+
+                vec3 target = position(collapse.to);
+                bool folds = false;
+                size_t dropped = 0;
+
+                // Triangles moving with the collapsed vertex must not flip or degenerate
+                for (int slot = offsets[collapse.from]; slot < offsets[collapse.from + 1] && not folds; slot++)
+                {
+                    const int* triangle = &current[adjacency[slot] * 3];
+
+                    if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    {
+                        dropped++;
+                        continue;
+                    }
+
+                    vec3 p[3], q[3];
+
+                    for (int corner = 0; corner < 3; corner++)
+                    {
+                        p[corner] = position(triangle[corner]);
+                        q[corner] = triangle[corner] == collapse.from ? target : p[corner];
+                    }
+
+                    vec3 before = cross(p[1] - p[0], p[2] - p[0]);
+                    vec3 after  = cross(q[1] - q[0], q[2] - q[0]);
+
+                    folds = dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+                }
+
+                if (folds) continue;
+
+                remap[collapse.from] = collapse.to;
+                quadrics[collapse.to].add(quadrics[collapse.from]);
+
+                // Neighbourhood changed, it waits for the next pass
+                for (int slot = offsets[collapse.from]; slot < offsets[collapse.from + 1]; slot++)
+                {
+                    const int* triangle = &current[adjacency[slot] * 3];
+
+                    touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+                }
+
+                removed += dropped;
+
+                if (removed >= needed) break;
+            }
+
+            if (removed == 0) break;
+
+            // Apply collapses dropping triangles that lost an edge
+            size_t write = 0;
+
+            for (size_t i = 0; i < current.size(); i += 3)
+            {
+                int a = remap[current[i]], b = remap[current[i + 1]], c = remap[current[i + 2]];
+
+                if (a == b || b == c || a == c) continue;
+
+                current[write++] = a;
+                current[write++] = b;
+                current[write++] = c;
+            }
+
+            current.resize(write);
+        }
+
+        return current;
+    }
+
+    void MeshSimplifier::build_lods(Mesh& mesh)
+    {
+        mesh.lods.clear();
+        mesh.lods.reserve(max_lods);
+
+        for (unsigned level = 1; level <= max_lods; level++)
+        {
+            const vector< int >& previous = level == 1 ? mesh.original_indices : mesh.lods.back().indices;
+
+            size_t triangles = previous.size() / 3;
+
+            if (triangles < min_triangles) break;
+
+            vector< int > indices = simplify(mesh, previous, triangles / 2);
+
+            // Not worth another level
+            if (indices.size() > previous.size() * 4 / 5) break;
+
+            MeshOptimizer::optimize_vertex_cache(indices, mesh.get_vertex_count());
+
+            mesh.lods.push_back({ std::move(indices), 0 });
+        }
+    }
+}
@@ -0,0 +1,168 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include "ModelCache.h"
+#include "VertexBatch.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+namespace MGVisualizer
+{
+    std::shared_ptr< const ModelCache::Model > ModelCache::get(const std::string& model_path)
+    {
+        std::shared_ptr< Model >& model = models[model_path];
+
+        if (model) return model;
+
+        model = std::make_shared< Model >(model_path);
+
+        // Loader thread only touches the shared model, which keeps its own copy of the path
+        loader.enqueue([model = model]
+        {
+            load_model_nodes(model->path.c_str(), model->meshes);
+            model->done.store(true, std::memory_order_release);
+        });
+
+        return model;
+    }
+
+    void ModelCache::load_model_nodes(const char* model_path, vector< Mesh >& target)
+    {
+        const unsigned import_flags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType | aiProcess_GenNormals;
+
+        // Skip importer if meshes were already flattened for this file
+        if (MeshCache::load(model_path, import_flags, target))
+            return;
+
+        // Create assimp importer
+        Assimp::Importer importer;
+
+        // Read 3D file scene
+        auto scene = importer.ReadFile(model_path, import_flags);
+
+        if (scene && scene->mNumMeshes > 0)
+        {
+            aiNode* root = scene->mRootNode;
+
+            // Meshes are built in place, reserve so the vector does not move them while growing
+            target.reserve(target.size() + count_node_meshes(root));
+
+            // Iterate each aiNode to render model properly
+            copy_nodes_recursive(root, scene, root->mTransformation, target);
+
+            MeshCache::save(model_path, import_flags, target);
+        }
+    }
+
+    size_t ModelCache::count_node_meshes(const aiNode* node)
+    {
+        size_t count = node->mNumMeshes;
+
+        for (unsigned i = 0; i < node->mNumChildren; i++)
+            count += count_node_meshes(node->mChildren[i]);
+
+        return count;
+    }
+
+    void ModelCache::copy_nodes_recursive(aiNode* node, const aiScene* scene, aiMatrix4x4 parentTransform, vector< Mesh >& target)
+    {
+        // If node has meshes copy them
+        if (node->mNumMeshes > 0)
+        {
+            copy_meshes(node, scene, parentTransform, target);
+        }
+
+        // Copy nodes foreach child in node
+        for (unsigned i = 0; i < node->mNumChildren; i++)
+        {
+            copy_nodes_recursive(node->mChildren[i], scene, parentTransform * node->mTransformation, target);
+        }
+    }
+
+    void ModelCache::copy_meshes(aiNode* node, const aiScene* scene, aiMatrix4x4 parentTransform, vector< Mesh >& target)
+    {
+        for (unsigned i = 0; i < node->mNumMeshes; i++)
+        {
+            // Make a MGMesh for each mesh in node, directly in target
+            Mesh& mgMesh = target.emplace_back();
+
+            // Get mesh
+            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+
+            // Get number of vertices and triangles and resize proper vectors
+            size_t vertices_number = mesh->mNumVertices;
+            size_t triangles_number = mesh->mNumFaces;
+
+            mgMesh.resize(vertices_number, triangles_number * 3);
+
+            // Get color of mesh
+            aiColor4D diffuse_color;
+
+            // Get material of mesh
+            auto material = scene->mMaterials[mesh->mMaterialIndex];
+            aiGetMaterialColor(material, AI_MATKEY_COLOR_DIFFUSE, &diffuse_color);
+
+            mgMesh.material_color.set(diffuse_color.r, diffuse_color.g, diffuse_color.b);
+
+            // Calculate transformation
+            mat4 transformation = aiToGlm(parentTransform) * aiToGlm(node->mTransformation);
+
+            // Iterate every vertex in mesh
+            for (size_t index = 0; index < mesh->mNumVertices; index++)
+            {
+                // Copy vertex coordinates
+                auto& vertex = mesh->mVertices[index];
+                vec4 position = transformation * vec4(vertex.x, vertex.y, vertex.z, 1.f);
+
+                mgMesh.positions_x[index] = position.x;
+                mgMesh.positions_y[index] = position.y;
+                mgMesh.positions_z[index] = position.z;
+
+                // Copy color coordinates
+                auto& normal = mesh->mNormals[index];
+                vec4 direction = transformation * vec4(normal.x, normal.y, normal.z, 0.f);
+
+                mgMesh.normals[index] = VertexBatch::encode_normal(vec3(direction));
+            }
+
+            auto indices_iterator = mgMesh.original_indices.begin();
+
+            // Generate indexes of triangles
+            for (size_t index = 0; index < mesh->mNumFaces; index++)
+            {
+                auto& face = mesh->mFaces[index];
+
+                // Make sure mesh is properly triangulated
+                assert(face.mNumIndices == 3);
+
+                auto indices = face.mIndices;
+
+                *indices_iterator++ = (int(indices[0]));
+                *indices_iterator++ = (int(indices[1]));
+                *indices_iterator++ = (int(indices[2]));
+            }
+
+            // Reorder triangles and vertices so consecutive triangles reuse nearby vertices
+            mgMesh.imported_acmr = MeshOptimizer::compute_acmr(mgMesh.original_indices.data(), mgMesh.original_indices.size(), vertices_number);
+
+            MeshOptimizer::optimize_vertex_cache(mgMesh.original_indices, vertices_number);
+            MeshSimplifier::build_lods(mgMesh);
+            MeshOptimizer::optimize_vertex_fetch(mgMesh);
+
+            mgMesh.compute_bounds();
+        }
+    }
+
+    mat4 ModelCache::aiToGlm(const aiMatrix4x4& from)
+    {
+        glm::mat4 to;
+        to[0][0] = from.a1; to[0][1] = from.b1; to[0][2] = from.c1; to[0][3] = from.d1;
+        to[1][0] = from.a2; to[1][1] = from.b2; to[1][2] = from.c2; to[1][3] = from.d2;
+        to[2][0] = from.a3; to[2][1] = from.b3; to[2][2] = from.c3; to[2][3] = from.d3;
+        to[3][0] = from.a4; to[3][1] = from.b4; to[3][2] = from.c4; to[3][3] = from.d4;
+        return to;
+    }
+}
@@ -0,0 +1,524 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <set>
+#include <string_view>
+#include "SceneFile.h"
+
+namespace MGVisualizer
+{
+    namespace
+    {
+        // Binary layout: Header, model paths, LightBlock of each light, then EntityBlock of each entity
+        // followed by its name. Strings are stored as their length followed by their characters, every
+        // block is padded to 4 bytes.
+
+        const char     sceneMagic[4] = { 'M', 'G', 'S', 'C' };
+        const uint32_t sceneVersion  = 1;
+
+        struct Header
+        {
+            char     magic[4];
+            uint32_t version;
+            uint32_t modelCount;
+            uint32_t lightCount;
+            uint32_t entityCount;
+            float    cameraPosition[3];
+            float    cameraRotation[3];
+        };
+
+        struct LightBlock
+        {
+            uint32_t type;
+            float    color[3];
+            float    intensity;
+            float    vector[3];
+            float    range;
+        };
+
+        struct EntityBlock
+        {
+            uint32_t model;
+            int32_t  parent;
+            float    position[3];
+            float    rotation[3];
+            float    scale[3];
+            float    spin[3];
+        };
+
+        size_t padded(size_t size)
+        {
+            return (size + 3) & ~size_t(3);
+        }
+
+        void write_block(std::ofstream& file, const void* data, size_t size)
+        {
+            static const char zeros[4] = { };
+
+            file.write(static_cast< const char* >(data), std::streamsize(size));
+            file.write(zeros, std::streamsize(padded(size) - size));
+        }
+
+        bool read_block(std::istream& file, void* data, size_t size)
+        {
+            char padding[4];
+
+            file.read(static_cast< char* >(data), std::streamsize(size));
+            file.read(padding, std::streamsize(padded(size) - size));
+
+            return bool(file);
+        }
+
+        void write_string(std::ofstream& file, const std::string& text)
+        {
+            uint32_t length = uint32_t(text.size());
+
+            write_block(file, &length, sizeof(length));
+            write_block(file, text.data(), text.size());
+        }
+
+        bool read_string(std::istream& file, std::string& text)
+        {
+            uint32_t length;
+
+            // Lengths above any path or name mean the file is corrupt
+            if (not read_block(file, &length, sizeof(length)) || length > 4096) return false;
+
+            text.resize(length);
+
+            return read_block(file, &text[0], length);
+        }
+
+        void copy(const vec3& from, float* to) { to[0] = from.x; to[1] = from.y; to[2] = from.z; }
+
+        vec3 to_vec3(const float* from) { return vec3(from[0], from[1], from[2]); }
+
+        /// <summary>
+        /// Words of one line of a text scene, numbers are parsed without locale or allocations
+        /// </summary>
+        class Tokens
+        {
+        private:
+
+            std::string_view line;
+
+        public:
+
+            Tokens(std::string_view text) : line(text) { }
+
+            bool next(std::string_view& token)
+            {
+                size_t start = line.find_first_not_of(" \t\r");
+
+                if (start == std::string_view::npos) return false;
+
+                size_t end = std::min(line.find_first_of(" \t\r", start), line.size());
+
+                token = line.substr(start, end - start);
+                line.remove_prefix(end);
+
+                return true;
+            }
+
+            bool next(float& value)
+            {
+                std::string_view token;
+
+                if (not next(token)) return false;
+
+                // from_chars does not take the leading plus sign people write by hand
+                if (token.size() > 1 && token[0] == '+') token.remove_prefix(1);
+
+                auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+
+                return result.ec == std::errc() && result.ptr == token.data() + token.size();
+            }
+
+            bool next(vec3& value)
+            {
+                return next(value.x) && next(value.y) && next(value.z);
+            }
+
+            bool at_end()
+            {
+                std::string_view token;
+
+                return not next(token);
+            }
+        };
+
+        /// <summary>
+        /// Shortest text reading back as the same float
+        /// </summary>
+        std::string to_text(float value)
+        {
+            char buffer[32];
+
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+
+            return std::string(buffer, result.ptr);
+        }
+
+        std::string to_text(const vec3& value)
+        {
+            return to_text(value.x) + ' ' + to_text(value.y) + ' ' + to_text(value.z);
+        }
+
+        bool fail(std::string* error, const std::string& message)
+        {
+            if (error != nullptr) *error = message;
+
+            return false;
+        }
+    }
+
+    bool SceneFile::load(const char* path, std::string* error)
+    {
+        std::ifstream file(path, std::ios::binary);
+
+        if (not file) return fail(error, std::string("cannot open ") + path);
+
+        models.clear();
+        entities.clear();
+        lights.clear();
+
+        camera_position = vec3(0.f);
+        camera_rotation = vec3(0.f);
+
+        // Binary files start with the magic, text files with a statement or comment
+        char magic[4] = { };
+
+        file.read(magic, sizeof(magic));
+
+        bool binary = file.gcount() == sizeof(magic) && std::memcmp(magic, sceneMagic, sizeof(magic)) == 0;
+
+        file.clear();
+        file.seekg(0);
+
+        return binary ? load_binary(file, error) : load_text(file, error);
+    }
+
+    bool SceneFile::load_text(std::istream& file, std::string* error)
+    {
+        // Entity names are only needed while parsing, records refer to parents by index
+        std::map< std::string, int32_t, std::less<> > names;
+
+        std::string line;
+        unsigned    lineNumber = 0;
+
+        while (std::getline(file, line))
+        {
+            lineNumber++;
+
+            std::string_view text(line);
+
+            text = text.substr(0, text.find('#'));
+
+            Tokens tokens(text);
+            std::string_view keyword;
+
+            if (not tokens.next(keyword)) continue;
+
+            std::string where = "line " + std::to_string(lineNumber) + ": ";
+
+            bool valid;
+
+            if (keyword == "camera")
+            {
+                valid = tokens.next(camera_position) && tokens.next(camera_rotation);
+            }
+            else if (keyword == "ambient" || keyword == "directional" || keyword == "point")
+            {
+                LightRecord light = { };
+
+                light.type = keyword == "ambient" ? Light::Ambient : keyword == "directional" ? Light::Directional : Light::Point;
+
+                valid = tokens.next(light.color) && tokens.next(light.intensity);
+
+                if (valid && light.type == Light::Directional)
+                    valid = tokens.next(light.vector);
+
+                if (valid && light.type == Light::Point)
+                    valid = tokens.next(light.vector) && tokens.next(light.range);
+
+                if (valid) lights.push_back(light);
+            }
+            else if (keyword == "entity")
+            {
+                EntityRecord entity;
+                std::string_view name, parent, model;
+
+                valid = tokens.next(name) && tokens.next(parent) && tokens.next(model) &&
+                        tokens.next(entity.position) && tokens.next(entity.rotation) && tokens.next(entity.scale);
+
+                if (valid)
+                {
+                    entity.parent = -1;
+
+                    if (parent != "-")
+                    {
+                        auto found = names.find(parent);
+
+                        if (found == names.end())
+                            return fail(error, where + "parent " + std::string(parent) + " is not declared before");
+
+                        entity.parent = found->second;
+                    }
+
+                    if (not names.emplace(std::string(name), int32_t(entities.size())).second)
+                        return fail(error, where + "entity " + std::string(name) + " is declared twice");
+
+                    entity.name = std::string(name);
+                    entity.model = add_model(std::string(model));
+                    entity.spin = vec3(0.f);
+
+                    entities.push_back(std::move(entity));
+                }
+            }
+            else if (keyword == "spin")
+            {
+                std::string_view name;
+                vec3 spin;
+
+                valid = tokens.next(name) && tokens.next(spin);
+
+                if (valid)
+                {
+                    auto found = names.find(name);
+
+                    if (found == names.end())
+                        return fail(error, where + "entity " + std::string(name) + " is not declared before");
+
+                    entities[found->second].spin = spin;
+                }
+            }
+            else
+                return fail(error, where + "unknown statement " + std::string(keyword));
+
+            if (not valid || not tokens.at_end())
+                return fail(error, where + "wrong arguments for " + std::string(keyword));
+        }
+
+        return true;
+    }
+
+    bool SceneFile::load_binary(std::istream& file, std::string* error)
+    {
+        Header header;
+
+        if (not read_block(file, &header, sizeof(header)) || header.version != sceneVersion)
+            return fail(error, "unsupported binary scene version");
+
+        camera_position = to_vec3(header.cameraPosition);
+        camera_rotation = to_vec3(header.cameraRotation);
+
+        // Counts come from the file, containers grow as records are read so a corrupt count
+        // ends at the first missing record instead of allocating for it
+        for (uint32_t i = 0; i < header.modelCount; i++)
+        {
+            std::string model;
+
+            if (not read_string(file, model)) return fail(error, "truncated model paths");
+
+            models.push_back(std::move(model));
+        }
+
+        for (uint32_t i = 0; i < header.lightCount; i++)
+        {
+            LightBlock block;
+
+            if (not read_block(file, &block, sizeof(block)) || block.type > Light::Point)
+                return fail(error, "malformed light " + std::to_string(i));
+
+            lights.push_back({ Light::Types(block.type), to_vec3(block.color), block.intensity, to_vec3(block.vector), block.range });
+        }
+
+        // Views find entities by name, so names are unique like in text files
+        std::set< std::string > names;
+
+        for (uint32_t i = 0; i < header.entityCount; i++)
+        {
+            EntityBlock block;
+            EntityRecord entity;
+
+            if (not read_block(file, &block, sizeof(block)) || not read_string(file, entity.name))
+                return fail(error, "truncated entity " + std::to_string(i));
+
+            // Same order rule as text files, parents before children
+            if (block.model >= header.modelCount || block.parent < -1 || block.parent >= int32_t(i))
+                return fail(error, "malformed entity " + entity.name);
+
+            if (not names.insert(entity.name).second)
+                return fail(error, "entity " + entity.name + " is declared twice");
+
+            entity.model = block.model;
+            entity.parent = block.parent;
+            entity.position = to_vec3(block.position);
+            entity.rotation = to_vec3(block.rotation);
+            entity.scale = to_vec3(block.scale);
+            entity.spin = to_vec3(block.spin);
+
+            entities.push_back(std::move(entity));
+        }
+
+        return true;
+    }
+
+    bool SceneFile::save(const char* path, bool binary) const
+    {
+        std::ofstream file(path, binary ? std::ios::binary | std::ios::trunc : std::ios::trunc);
+
+        if (not file) return false;
+
+        if (binary)
+        {
+            Header header = { };
+            std::memcpy(header.magic, sceneMagic, sizeof(sceneMagic));
+            header.version = sceneVersion;
+            header.modelCount = uint32_t(models.size());
+            header.lightCount = uint32_t(lights.size());
+            header.entityCount = uint32_t(entities.size());
+            copy(camera_position, header.cameraPosition);
+            copy(camera_rotation, header.cameraRotation);
+
+            write_block(file, &header, sizeof(header));
+
+            for (const std::string& model : models)
+                write_string(file, model);
+
+            for (const LightRecord& light : lights)
+            {
+                LightBlock block = { };
+                block.type = uint32_t(light.type);
+                copy(light.color, block.color);
+                block.intensity = light.intensity;
+                copy(light.vector, block.vector);
+                block.range = light.range;
+
+                write_block(file, &block, sizeof(block));
+            }
+
+            for (const EntityRecord& entity : entities)
+            {
+                EntityBlock block = { };
+                block.model = entity.model;
+                block.parent = entity.parent;
+                copy(entity.position, block.position);
+                copy(entity.rotation, block.rotation);
+                copy(entity.scale, block.scale);
+                copy(entity.spin, block.spin);
+
+                write_block(file, &block, sizeof(block));
+                write_string(file, entity.name);
+            }
+        }
+        else
+        {
+            file << "# MGSceneLoader scene, " << entities.size() << " entities\n\n";
+
+            file << "camera " << to_text(camera_position) << "  " << to_text(camera_rotation) << "\n\n";
+
+            for (const LightRecord& light : lights)
+            {
+                switch (light.type)
+                {
+                    case Light::Ambient:
+                        file << "ambient " << to_text(light.color) << "  " << to_text(light.intensity) << '\n';
+                        break;
+                    case Light::Directional:
+                        file << "directional " << to_text(light.color) << "  " << to_text(light.intensity) << "  " << to_text(light.vector) << '\n';
+                        break;
+                    case Light::Point:
+                        file << "point " << to_text(light.color) << "  " << to_text(light.intensity) << "  " << to_text(light.vector) << "  " << to_text(light.range) << '\n';
+                        break;
+                }
+            }
+
+            file << '\n';
+
+            for (const EntityRecord& entity : entities)
+            {
+                file << "entity " << entity.name << ' ' << (entity.parent < 0 ? std::string("-") : entities[entity.parent].name) << ' '
+                     << models[entity.model] << "  " << to_text(entity.position) << "  " << to_text(entity.rotation) << "  " << to_text(entity.scale) << '\n';
+
+                if (entity.spin != vec3(0.f))
+                    file << "spin " << entity.name << ' ' << to_text(entity.spin) << '\n';
+            }
+        }
+
+        return bool(file);
+    }
+
+    uint32_t SceneFile::add_model(const std::string& path)
+    {
+        // Scenes reference a handful of models, a linear search is enough
+        auto found = std::find(models.begin(), models.end(), path);
+
+        if (found != models.end()) return uint32_t(found - models.begin());
+
+        models.push_back(path);
+
+        return uint32_t(models.size() - 1);
+    }
+
+    SceneFile SceneFile::generate_stress(unsigned entity_count, unsigned seed)
+    {
+        SceneFile scene;
+
+        std::mt19937 random(seed);
+
+        auto uniform = [&random](float min, float max)
+        {
+            return std::uniform_real_distribution< float >(min, max)(random);
+        };
+
+        scene.camera_position = vec3(120.f, -40.f, 0.f);
+        scene.camera_rotation = vec3(10.f, 35.f, 0.f);
+
+        scene.lights.push_back({ Light::Ambient, vec3(1.f), 0.1f, vec3(0.f), 0.f });
+        scene.lights.push_back({ Light::Directional, vec3(1.f), 1.f, vec3(1.f, -1.f, 0.f), 0.f });
+
+        uint32_t terrain = scene.add_model("../binaries/japan.fbx");
+        uint32_t deer = scene.add_model("../binaries/deer.obj");
+        uint32_t cloud = scene.add_model("../binaries/Cloud.obj");
+        uint32_t eagle = scene.add_model("../binaries/eagle.obj");
+
+        scene.entities.reserve(entity_count);
+        scene.entities.push_back({ "japan", terrain, -1, vec3(20.f, 30.f, -140.f), vec3(180.f, 270.f, 0.f), vec3(0.1f), vec3(0.f, 0.1f, 0.f) });
+
+        // Half deer, a quarter clouds and a quarter eagles following the last cloud, in terrain coordinates
+        int32_t lastCloud = -1;
+
+        for (unsigned i = 1; i < entity_count; i++)
+        {
+            std::string number = std::to_string(i);
+
+            if (i % 4 == 1 || i % 4 == 3)
+            {
+                vec3 position(uniform(-600.f, 600.f), 90.f, uniform(-600.f, 600.f));
+
+                scene.entities.push_back({ "deer" + number, deer, 0, position, vec3(0.f, uniform(0.f, 360.f), 0.f), vec3(0.2f), vec3(0.f) });
+            }
+            else if (i % 4 == 2 || lastCloud < 0)
+            {
+                vec3 position(uniform(-800.f, 800.f), uniform(900.f, 1100.f), uniform(-800.f, 800.f));
+
+                lastCloud = int32_t(scene.entities.size());
+
+                scene.entities.push_back({ "cloud" + number, cloud, 0, position, vec3(0.f), vec3(uniform(40.f, 80.f)), vec3(0.f, uniform(-1.f, 1.f), 0.f) });
+            }
+            else
+                scene.entities.push_back({ "eagle" + number, eagle, lastCloud, vec3(5.f, 0.f, 0.f), vec3(0.f), vec3(0.1f), vec3(0.f) });
+        }
+
+        return scene;
+    }
+}
@@ -0,0 +1,335 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include <algorithm>
+#include <cstring>
+#include "SpanFiller.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    #define MG_SPAN_X86 1
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#endif
+
+// MSVC accepts AVX2 intrinsics anywhere, GCC and Clang need the function to be compiled for it
+#if defined(MG_SPAN_X86) && (defined(__GNUC__) || defined(__clang__))
+    #define MG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define MG_TARGET_AVX2
+#endif
+
+namespace MGVisualizer
+{
+    namespace
+    {
+        // Write color in every pixel whose bit is set in mask
+        inline void write_masked(Rgb888* pixels, unsigned mask, const Rgb888& color)
+        {
+            while (mask != 0)
+            {
+                unsigned bit = 0;
+                while (not (mask & (1u << bit))) bit++;
+
+                pixels[bit] = color;
+                mask &= mask - 1;
+            }
+        }
+
+    #ifdef MG_SPAN_X86
+
+        // Depth test four pixels and write the ones passing it
+        inline void fill_4(int* depths, Rgb888* pixels, __m128i lane_z, const unsigned char* pattern, const Rgb888& color)
+        {
+            __m128i stored = _mm_loadu_si128(reinterpret_cast< const __m128i* >(depths));
+            __m128i passed = _mm_cmplt_epi32(lane_z, stored);
+
+            unsigned mask = unsigned(_mm_movemask_ps(_mm_castsi128_ps(passed)));
+
+            if (mask != 0)
+            {
+                __m128i merged = _mm_or_si128(_mm_and_si128(passed, lane_z), _mm_andnot_si128(passed, stored));
+                _mm_storeu_si128(reinterpret_cast< __m128i* >(depths), merged);
+
+                if (mask == 0xF)
+                    std::memcpy(pixels, pattern, 12);
+                else
+                    write_masked(pixels, mask, color);
+            }
+        }
+
+        // Depth test eight pixels and write the ones passing it
+        MG_TARGET_AVX2
+        inline void fill_8(int* depths, Rgb888* pixels, __m256i lane_z, const unsigned char* pattern, const Rgb888& color)
+        {
+            __m256i stored = _mm256_loadu_si256(reinterpret_cast< const __m256i* >(depths));
+            __m256i passed = _mm256_cmpgt_epi32(stored, lane_z);
+
+            unsigned mask = unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(passed)));
+
+            if (mask != 0)
+            {
+                _mm256_maskstore_epi32(depths, passed, lane_z);
+
+                if (mask == 0xFF)
+                    std::memcpy(pixels, pattern, 24);
+                else
+                    write_masked(pixels, mask, color);
+            }
+        }
+
+    #endif
+    }
+
+    SpanFiller::Kernels SpanFiller::get_best_kernel()
+    {
+        if (is_supported(AVX2)) return AVX2;
+        if (is_supported(SSE2)) return SSE2;
+
+        return Scalar;
+    }
+
+    bool SpanFiller::is_supported(Kernels kernel)
+    {
+        switch (kernel)
+        {
+            case Scalar: return true;
+
+        #ifdef MG_SPAN_X86
+            #ifdef _MSC_VER
+            case SSE2:
+            {
+                int registers[4];
+                __cpuid(registers, 1);
+                return (registers[3] & (1 << 26)) != 0;
+            }
+            case AVX2:
+            {
+                int registers[4];
+                __cpuid(registers, 0);
+                if (registers[0] < 7) return false;
+
+                // OS must save YMM registers
+                __cpuid(registers, 1);
+                bool osxsave = (registers[2] & (1 << 27)) != 0;
+                if (not osxsave || (_xgetbv(0) & 6) != 6) return false;
+
+                __cpuidex(registers, 7, 0);
+                return (registers[1] & (1 << 5)) != 0;
+            }
+            #else
+            case SSE2: return __builtin_cpu_supports("sse2");
+            case AVX2: return __builtin_cpu_supports("avx2");
+            #endif
+        #endif
+
+            default: return false;
+        }
+    }
+
+    SpanFiller::Function SpanFiller::get_function(Kernels kernel)
+    {
+        switch (kernel)
+        {
+            case SSE2: return fill_sse2;
+            case AVX2: return fill_avx2;
+            default:   return fill_scalar;
+        }
+    }
+
+    SpanFiller::Reversed_Function SpanFiller::get_reversed_function(Kernels kernel)
+    {
+        switch (kernel)
+        {
+            case SSE2: return fill_reversed_sse2;
+            case AVX2: return fill_reversed_avx2;
+            default:   return fill_reversed_scalar;
+        }
+    }
+
+    const char* SpanFiller::get_kernel_name(Kernels kernel)
+    {
+        switch (kernel)
+        {
+            case Scalar: return "scalar";
+            case SSE2:   return "sse2";
+            case AVX2:   return "avx2";
+            default:     return "unknown";
+        }
+    }
+
+    void SpanFiller::fill_scalar(int* depths, Rgb888* pixels, int count, int64_t z, int64_t z_step, const Rgb888& color)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            int key = int(z >> 32);
+
+            if (key < depths[i])
+            {
+                pixels[i] = color;
+                depths[i] = key;
+            }
+
+            z += z_step;
+        }
+    }
+
+    void SpanFiller::fill_reversed_scalar(int* depths, Rgb888* pixels, int count, float depth, float depth_step, const Rgb888& color)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            // Depth of each pixel is computed from the start of the span so no error accumulates
+            int z = get_reversed_depth_key(std::max(depth + float(i) * depth_step, 0.f));
+
+            if (z < depths[i])
+            {
+                pixels[i] = color;
+                depths[i] = z;
+            }
+        }
+    }
+
+#ifdef MG_SPAN_X86
+
+    void SpanFiller::fill_sse2(int* depths, Rgb888* pixels, int count, int64_t z, int64_t z_step, const Rgb888& color)
+    {
+        // Four pixels of color packed to store them at once
+        unsigned char pattern[12];
+        for (int i = 0; i < 4; i++) std::memcpy(pattern + i * 3, &color, 3);
+
+        // Depths of pixels 0, 1 and 2, 3 stepped in 64 bits, their high halves are the keys
+        __m128i lanes_low  = _mm_set_epi64x(z + z_step, z);
+        __m128i lanes_high = _mm_set_epi64x(z + 3 * z_step, z + 2 * z_step);
+
+        __m128i step = _mm_set1_epi64x(4 * z_step);
+
+        int i = 0;
+
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i lane_z = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lanes_low), _mm_castsi128_ps(lanes_high), _MM_SHUFFLE(3, 1, 3, 1)));
+
+            fill_4(depths + i, pixels + i, lane_z, pattern, color);
+
+            lanes_low  = _mm_add_epi64(lanes_low,  step);
+            lanes_high = _mm_add_epi64(lanes_high, step);
+        }
+
+        fill_scalar(depths + i, pixels + i, count - i, z + i * z_step, z_step, color);
+    }
+
+    void SpanFiller::fill_reversed_sse2(int* depths, Rgb888* pixels, int count, float depth, float depth_step, const Rgb888& color)
+    {
+        unsigned char pattern[12];
+        for (int i = 0; i < 4; i++) std::memcpy(pattern + i * 3, &color, 3);
+
+        // Same operations as the scalar loop so every kernel gives the same depths
+        __m128 start = _mm_set1_ps(depth);
+        __m128 step  = _mm_set1_ps(depth_step);
+        __m128 index = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+        __m128 four  = _mm_set1_ps(4.f);
+        __m128 zero  = _mm_setzero_ps();
+        __m128i one  = _mm_set1_epi32(int(reversed_one));
+
+        int i = 0;
+
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 lane_depth = _mm_max_ps(_mm_add_ps(start, _mm_mul_ps(index, step)), zero);
+            __m128i lane_z = _mm_sub_epi32(one, _mm_castps_si128(lane_depth));
+
+            fill_4(depths + i, pixels + i, lane_z, pattern, color);
+
+            index = _mm_add_ps(index, four);
+        }
+
+        for (; i < count; i++)
+            fill_reversed_scalar(depths + i, pixels + i, 1, depth + float(i) * depth_step, 0.f, color);
+    }
+
+    MG_TARGET_AVX2
+    void SpanFiller::fill_avx2(int* depths, Rgb888* pixels, int count, int64_t z, int64_t z_step, const Rgb888& color)
+    {
+        // Eight pixels of color packed to store them at once
+        unsigned char pattern[24];
+        for (int i = 0; i < 8; i++) std::memcpy(pattern + i * 3, &color, 3);
+
+        __m256i lanes_low  = _mm256_set_epi64x(z + 3 * z_step, z + 2 * z_step, z + z_step, z);
+        __m256i lanes_high = _mm256_set_epi64x(z + 7 * z_step, z + 6 * z_step, z + 5 * z_step, z + 4 * z_step);
+
+        __m256i step = _mm256_set1_epi64x(8 * z_step);
+
+        int i = 0;
+
+        for (; i + 8 <= count; i += 8)
+        {
+            // Shuffle works inside each 128 bit half, leaving keys in order 0 1 4 5 2 3 6 7
+            __m256i keys = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(lanes_low), _mm256_castsi256_ps(lanes_high), _MM_SHUFFLE(3, 1, 3, 1)));
+            __m256i lane_z = _mm256_permute4x64_epi64(keys, _MM_SHUFFLE(3, 1, 2, 0));
+
+            fill_8(depths + i, pixels + i, lane_z, pattern, color);
+
+            lanes_low  = _mm256_add_epi64(lanes_low,  step);
+            lanes_high = _mm256_add_epi64(lanes_high, step);
+        }
+
+        fill_scalar(depths + i, pixels + i, count - i, z + i * z_step, z_step, color);
+    }
+
+    MG_TARGET_AVX2
+    void SpanFiller::fill_reversed_avx2(int* depths, Rgb888* pixels, int count, float depth, float depth_step, const Rgb888& color)
+    {
+        unsigned char pattern[24];
+        for (int i = 0; i < 8; i++) std::memcpy(pattern + i * 3, &color, 3);
+
+        // Multiply and add stay separate, a fused multiply-add would round differently than the scalar loop
+        __m256 start = _mm256_set1_ps(depth);
+        __m256 step  = _mm256_set1_ps(depth_step);
+        __m256 index = _mm256_set_ps(7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f);
+        __m256 eight = _mm256_set1_ps(8.f);
+        __m256 zero  = _mm256_setzero_ps();
+        __m256i one  = _mm256_set1_epi32(int(reversed_one));
+
+        int i = 0;
+
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 lane_depth = _mm256_max_ps(_mm256_add_ps(start, _mm256_mul_ps(index, step)), zero);
+            __m256i lane_z = _mm256_sub_epi32(one, _mm256_castps_si256(lane_depth));
+
+            fill_8(depths + i, pixels + i, lane_z, pattern, color);
+
+            index = _mm256_add_ps(index, eight);
+        }
+
+        for (; i < count; i++)
+            fill_reversed_scalar(depths + i, pixels + i, 1, depth + float(i) * depth_step, 0.f, color);
+    }
+
+#else
+
+    void SpanFiller::fill_sse2(int* depths, Rgb888* pixels, int count, int64_t z, int64_t z_step, const Rgb888& color)
+    {
+        fill_scalar(depths, pixels, count, z, z_step, color);
+    }
+
+    void SpanFiller::fill_avx2(int* depths, Rgb888* pixels, int count, int64_t z, int64_t z_step, const Rgb888& color)
+    {
+        fill_scalar(depths, pixels, count, z, z_step, color);
+    }
+
+    void SpanFiller::fill_reversed_sse2(int* depths, Rgb888* pixels, int count, float depth, float depth_step, const Rgb888& color)
+    {
+        fill_reversed_scalar(depths, pixels, count, depth, depth_step, color);
+    }
+
+    void SpanFiller::fill_reversed_avx2(int* depths, Rgb888* pixels, int count, float depth, float depth_step, const Rgb888& color)
+    {
+        fill_reversed_scalar(depths, pixels, count, depth, depth_step, color);
+    }
+
+#endif
+}
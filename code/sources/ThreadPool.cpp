@@ -0,0 +1,152 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include "ThreadPool.h"
+
+namespace MGVisualizer
+{
+    ThreadPool::ThreadPool(unsigned worker_count)
+        :
+        job(nullptr),
+        taskCount(0),
+        nextTask(0),
+        pendingThreads(0),
+        generation(0),
+        stopping(false),
+        runningJobs(0)
+    {
+        if (worker_count == 0)
+            worker_count = std::thread::hardware_concurrency();
+
+        // Calling thread is always worker 0
+        for (unsigned worker = 1; worker < worker_count; worker++)
+        {
+            threads.emplace_back(&ThreadPool::worker_loop, this, worker);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard< std::mutex > lock(mutex);
+            stopping = true;
+        }
+
+        wake_condition.notify_all();
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    void ThreadPool::parallel_for(unsigned count, const Task& task)
+    {
+        if (count == 0) return;
+
+        // Nothing to share work with
+        if (threads.empty() || count == 1)
+        {
+            for (unsigned index = 0; index < count; index++)
+                task(index, 0);
+
+            return;
+        }
+
+        {
+            std::lock_guard< std::mutex > lock(mutex);
+
+            job = &task;
+            taskCount = count;
+            nextTask = 0;
+            pendingThreads = unsigned(threads.size());
+            generation++;
+        }
+
+        wake_condition.notify_all();
+
+        run_tasks(0);
+
+        std::unique_lock< std::mutex > lock(mutex);
+        done_condition.wait(lock, [this] { return pendingThreads == 0; });
+
+        job = nullptr;
+    }
+
+    void ThreadPool::enqueue(Job job)
+    {
+        if (threads.empty())
+        {
+            job();
+            return;
+        }
+
+        {
+            std::lock_guard< std::mutex > lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+
+        wake_condition.notify_one();
+    }
+
+    void ThreadPool::wait_idle()
+    {
+        std::unique_lock< std::mutex > lock(mutex);
+        idle_condition.wait(lock, [this] { return jobs.empty() && runningJobs == 0; });
+    }
+
+    void ThreadPool::worker_loop(unsigned worker)
+    {
+        unsigned lastGeneration = 0;
+
+        while (true)
+        {
+            Job job;
+
+            {
+                std::unique_lock< std::mutex > lock(mutex);
+                wake_condition.wait(lock, [&] { return stopping || generation != lastGeneration || not jobs.empty(); });
+
+                if (stopping) return;
+
+                // Indexed tasks go first since the calling thread is waiting for them
+                if (generation != lastGeneration)
+                    lastGeneration = generation;
+                else
+                {
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                    runningJobs++;
+                }
+            }
+
+            if (job)
+            {
+                job();
+
+                std::lock_guard< std::mutex > lock(mutex);
+
+                if (--runningJobs == 0 && jobs.empty())
+                    idle_condition.notify_all();
+
+                continue;
+            }
+
+            run_tasks(worker);
+
+            std::lock_guard< std::mutex > lock(mutex);
+
+            if (--pendingThreads == 0)
+                done_condition.notify_one();
+        }
+    }
+
+    void ThreadPool::run_tasks(unsigned worker)
+    {
+        // Take tasks until none is left
+        for (unsigned task = nextTask++; task < taskCount; task = nextTask++)
+        {
+            (*job)(task, worker);
+        }
+    }
+}
@@ -28,6 +28,7 @@ namespace MGVisualizer
 	void Transform::set_transformation(mat4 newTransformation)
 	{
 		transformationMatrix = newTransformation;
+		changed = true;
 	}
 
 	const vec3 Transform::get_forward()
@@ -73,5 +74,6 @@ namespace MGVisualizer
 		mat4 translationMatrix = glm::translate(identity, position);
 
 		transformationMatrix = translationMatrix * rotationMatrix * scalingMatrix;
+		changed = true;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+
+// Distributed under MIT License
+// @miguelgutierrezruano
+// 2023
+
+#include <algorithm>
+#include <cmath>
+#include "VertexBatch.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+    #define MG_VERTEX_SSE 1
+    #include <emmintrin.h>
+#endif
+
+namespace MGVisualizer
+{
+    void VertexBatch::transform_positions(const mat4& matrix, const float* x, const float* y, const float* z, size_t count, vec4* output)
+    {
+        size_t i = 0;
+
+    #ifdef MG_VERTEX_SSE
+
+        // Broadcast every matrix element once per mesh
+        __m128 m[4][4];
+
+        for (int column = 0; column < 4; column++)
+            for (int row = 0; row < 4; row++)
+                m[column][row] = _mm_set1_ps(matrix[column][row]);
+
+        // Four vertices per iteration, one vertex per lane
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 vx = _mm_loadu_ps(x + i);
+            __m128 vy = _mm_loadu_ps(y + i);
+            __m128 vz = _mm_loadu_ps(z + i);
+
+            __m128 result[4];
+
+            // Same sum order as glm matrix by vector product
+            for (int row = 0; row < 4; row++)
+            {
+                __m128 xy = _mm_add_ps(_mm_mul_ps(m[0][row], vx), _mm_mul_ps(m[1][row], vy));
+                __m128 zw = _mm_add_ps(_mm_mul_ps(m[2][row], vz), m[3][row]);
+
+                result[row] = _mm_add_ps(xy, zw);
+            }
+
+            // Back to one vec4 per vertex
+            _MM_TRANSPOSE4_PS(result[0], result[1], result[2], result[3]);
+
+            float* destination = &output[i].x;
+
+            _mm_storeu_ps(destination +  0, result[0]);
+            _mm_storeu_ps(destination +  4, result[1]);
+            _mm_storeu_ps(destination +  8, result[2]);
+            _mm_storeu_ps(destination + 12, result[3]);
+        }
+
+    #endif
+
+        for (; i < count; i++)
+        {
+            output[i] = matrix * vec4(x[i], y[i], z[i], 1.f);
+        }
+    }
+
+    void VertexBatch::transform_normals(const mat3& matrix, const uint32_t* normals, size_t count, vec4* output)
+    {
+        size_t i = 0;
+
+    #ifdef MG_VERTEX_SSE
+
+        __m128 m[3][3];
+
+        for (int column = 0; column < 3; column++)
+            for (int row = 0; row < 3; row++)
+                m[column][row] = _mm_set1_ps(matrix[column][row]);
+
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 sign = _mm_set1_ps(-0.f);
+        const __m128 scale = _mm_set1_ps(1.f / 32767.f);
+
+        for (; i + 4 <= count; i += 4)
+        {
+            // Low and high halves are the signed coordinates in the folded octahedron
+            __m128i encoded = _mm_loadu_si128(reinterpret_cast< const __m128i* >(normals + i));
+
+            __m128 vx = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(encoded, 16), 16)), scale);
+            __m128 vy = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(encoded, 16)), scale);
+            __m128 vz = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(sign, vx)), _mm_andnot_ps(sign, vy));
+
+            // Unfold lower hemisphere, moving x and y towards zero by the depth below the square
+            __m128 fold = _mm_max_ps(_mm_sub_ps(zero, vz), zero);
+
+            vx = _mm_sub_ps(vx, _mm_xor_ps(fold, _mm_and_ps(sign, vx)));
+            vy = _mm_sub_ps(vy, _mm_xor_ps(fold, _mm_and_ps(sign, vy)));
+
+            __m128 result[4];
+
+            for (int row = 0; row < 3; row++)
+            {
+                result[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][row], vx), _mm_mul_ps(m[1][row], vy)), _mm_mul_ps(m[2][row], vz));
+            }
+
+            // Normalize
+            __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(result[0], result[0]), _mm_mul_ps(result[1], result[1])), _mm_mul_ps(result[2], result[2]));
+            __m128 inverse_length = _mm_div_ps(one, _mm_sqrt_ps(length2));
+
+            result[0] = _mm_mul_ps(result[0], inverse_length);
+            result[1] = _mm_mul_ps(result[1], inverse_length);
+            result[2] = _mm_mul_ps(result[2], inverse_length);
+            result[3] = _mm_setzero_ps();
+
+            _MM_TRANSPOSE4_PS(result[0], result[1], result[2], result[3]);
+
+            float* destination = &output[i].x;
+
+            _mm_storeu_ps(destination +  0, result[0]);
+            _mm_storeu_ps(destination +  4, result[1]);
+            _mm_storeu_ps(destination +  8, result[2]);
+            _mm_storeu_ps(destination + 12, result[3]);
+        }
+
+    #endif
+
+        for (; i < count; i++)
+        {
+            vec3 normal = normalize(matrix * decode_normal(normals[i]));
+
+            output[i] = vec4(normal, 0.f);
+        }
+    }
+
+    uint32_t VertexBatch::encode_normal(const vec3& direction)
+    {
+        float sum = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+
+        // Zero length normals would divide by zero, they are stored as (0, 0, 1) whose encoding is zero
+        if (sum < 1e-20f) return 0;
+
+        // Project on the octahedron |x| + |y| + |z| = 1
+        vec3 normal = direction / sum;
+
+        // Fold lower half over the upper one along the diagonals
+        if (normal.z < 0.f)
+        {
+            float x = normal.x;
+
+            normal.x = (1.f - std::abs(normal.y)) * (x        >= 0.f ? 1.f : -1.f);
+            normal.y = (1.f - std::abs(x       )) * (normal.y >= 0.f ? 1.f : -1.f);
+        }
+
+        int u = int(std::lround(std::clamp(normal.x, -1.f, 1.f) * 32767.f));
+        int v = int(std::lround(std::clamp(normal.y, -1.f, 1.f) * 32767.f));
+
+        return uint32_t(uint16_t(int16_t(u))) | uint32_t(uint16_t(int16_t(v))) << 16;
+    }
+
+    vec3 VertexBatch::decode_normal(uint32_t normal)
+    {
+        const float scale = 1.f / 32767.f;
+
+        vec3 direction;
+        direction.x = float(int16_t(uint16_t(normal      ))) * scale;
+        direction.y = float(int16_t(uint16_t(normal >> 16))) * scale;
+        direction.z = 1.f - std::abs(direction.x) - std::abs(direction.y);
+
+        float fold = std::max(-direction.z, 0.f);
+
+        direction.x -= direction.x >= 0.f ? fold : -fold;
+        direction.y -= direction.y >= 0.f ? fold : -fold;
+
+        return direction;
+    }
+}
@@ -6,6 +6,7 @@
 #include <iostream>
 #include <cassert>
 #include <cmath>
+#include <limits>
 #include "View.h"
 
 #include <assimp/Importer.hpp>
@@ -21,93 +22,207 @@ namespace MGVisualizer
         :
         width(width),
         height(height),
+        models(loaders),
+        loadStart(FrameStats::Clock::now()),
+        loadTime(0.0),
+        sceneLoaded(false),
         color_buffer(width, height),
-        rasterizer(color_buffer)
+        rasterizer(color_buffer),
+        tiledRasterizer(rasterizer, workers, frameArena),
+        tiledRendering(true),
+        fusedVertexStage(true)
     { 
-        // Create entities
-        Entity* japan = new Entity("../binaries/japan.fbx");
-        entities.emplace("japan", japan);
+        set_guard_band(2.f);
 
-        entities["japan"]->get_transform()->set_position(vec3(20.f, 30.f, -140.f));
-        entities["japan"]->get_transform()->set_rotation(vec3(180, 270, 0.f));
-        entities["japan"]->get_transform()->set_scale(vec3(0.1f, 0.1f, 0.1f));
+        rasterizer.set_near_plane(camera.get_near_plane());
 
-        Entity* deer = new Entity("../binaries/deer.obj", japan);
-        entities.emplace("deer", deer);
+        // Levels 1, 2 and 3 below these fractions of viewport height
+        lodThresholds = { 0.25f, 0.12f, 0.05f };
 
-        entities["deer"]->get_transform()->set_position(vec3(400.f, 90.f, 360.f));
-        entities["deer"]->get_transform()->set_rotation(vec3(0, 0, 0.f));
-        entities["deer"]->get_transform()->set_scale(vec3(0.2f, 0.2f, 0.2f));
+        mouseLastPosition = vec2();
+    }
 
-        Entity* cloud = new Entity("../binaries/Cloud.obj", japan);
-        entities.emplace("cloud", cloud);
+    bool View::load_scene(const char* scene_path, std::string* error)
+    {
+        SceneFile scene;
 
-        entities["cloud"]->get_transform()->set_position(vec3(0.f, 1000.f, 0.f));
-        entities["cloud"]->get_transform()->set_rotation(vec3(0, 0, 0.f));
-        entities["cloud"]->get_transform()->set_scale(vec3(70.f, 70.f, 70.f));
+        if (not scene.load(scene_path, error)) return false;
 
-        Entity* eagle = new Entity("../binaries/eagle.obj", cloud);
-        entities.emplace("eagle", eagle);
+        load_scene(scene);
 
-        entities["eagle"]->get_transform()->set_position(vec3(5.f, 0.f, 0.f));
-        entities["eagle"]->get_transform()->set_rotation(vec3(0, 0, 0.f));
-        entities["eagle"]->get_transform()->set_scale(vec3(0.1f, 0.1f, 0.1f));
+        return true;
+    }
 
-        // Set camera transformation
-        camera.transform.set_position(vec3(120, -40, 0));
-        camera.transform.set_rotation(vec3(10, 35, 0));
+    void View::load_scene(const SceneFile& scene)
+    {
+        assert(entities.empty());
 
-        // Create lights
-        Light* ambientLight = new Light();
-        ambientLight->set_intensity(0.1f);
-        lights.push_back(ambientLight);
+        loadStart = FrameStats::Clock::now();
+        sceneLoaded = false;
 
-        DirectionalLight* dirLight = new DirectionalLight(vec3(1.f, -1.f, 0.f));
-        dirLight->set_intensity(1.f);
-        lights.push_back(dirLight);
+        // Parents come first in the file as in the entity array, so their handles are the record indices
+        entities.reserve(scene.entities.size());
 
-        mouseLastPosition = vec2();
+        for (const SceneFile::EntityRecord& record : scene.entities)
+        {
+            EntityHandle parent = record.parent < 0 ? no_entity : EntityHandle(record.parent);
+            EntityHandle handle = add_entity(record.name, scene.models[record.model].c_str(), parent);
 
-        worldRotation = 0;
-        cloudRotation = 0;
+            Transform* transform = entities[handle].get_transform();
+            transform->set_position(record.position);
+            transform->set_rotation(record.rotation);
+            transform->set_scale(record.scale);
+
+            if (record.spin != vec3(0.f))
+                spins.push_back({ handle, record.rotation, record.spin, vec3(0.f) });
+        }
+
+        camera.transform.set_position(scene.camera_position);
+        camera.transform.set_rotation(scene.camera_rotation);
+
+        for (const SceneFile::LightRecord& record : scene.lights)
+        {
+            Light* light;
+
+            if (record.type == Light::Directional)
+                light = new DirectionalLight(record.vector);
+            else if (record.type == Light::Point)
+                light = new PointLight(record.vector, record.range);
+            else
+                light = new Light();
+
+            light->set_color(Color(record.color.r, record.color.g, record.color.b));
+            light->set_intensity(record.intensity);
+            lights.push_back(light);
+        }
     }
 
     void View::update()
     {
-        cloudRotation -= 0.5f;
-        worldRotation += 0.1f;
+        stats.reset();
+
+        // Transient data of the previous frame is no longer used
+        frameArena.reset();
+
+        is_scene_loaded();
 
-        entities["japan"]->get_transform()->set_rotation(vec3(vec3(180, 270 + worldRotation, 0.f)));
-		entities["cloud"]->get_transform()->set_rotation(vec3(0, cloudRotation, 0.f));
+        for (Spin& spin : spins)
+        {
+            spin.angle += spin.speed;
+
+            entities[spin.entity].get_transform()->set_rotation(spin.rotation + spin.angle);
+        }
 
         // Get projection matrix by moving the camera to (0, 0, 0) and the projection matrix
         mat4 inverseCamera = inverse(camera.transform.get_matrix());
         mat4 projection = camera.get_projection_matrix(float(width) / height) * inverseCamera;
 
+        FrameStats::Clock::time_point start = FrameStats::Clock::now();
+
+        lightTable.compile(lights);
+
+        stats.add_time(FrameStats::Lighting, start);
+        start = FrameStats::Clock::now();
+
+        // Refresh world matrices of moved entities and their children in one pass, parents come first
+        for (Entity& entity : entities)
+        {
+            EntityHandle parent = entity.get_parent();
+
+            entity.update_world_matrix(parent != no_entity ? &entities[parent] : nullptr, stats);
+        }
+
         // Update each entity
-        for (auto& [name, entity] : entities)
-            entity->update(projection);
+        for (Entity& entity : entities)
+            entity.update(projection, this);
+
+        stats.add_time(FrameStats::VertexTransform, start);
     }
 
     void View::render()
     {
-        // Transform to display coordinates
+        // Transform to display coordinates, in fixed point when the rasterizer takes sub-pixel positions.
+        // Depth is replaced by the rasterizer depth key of each vertex.
+        float subpixel = float(1 << rasterizer.get_subpixel_bits());
+
         mat4 identity(1);
-        mat4 scaling = scale(identity, glm::vec3(float(width / 2), float(height / 2), 1000000.f));
-        mat4 translation = translate(identity, glm::vec3(float(width / 2), float(height / 2), 0.f));
+        mat4 scaling = scale(identity, glm::vec3(float(width / 2) * subpixel, float(height / 2) * subpixel, 1.f));
+        mat4 translation = translate(identity, glm::vec3(float(width / 2) * subpixel, float(height / 2) * subpixel, 0.f));
         mat4 transformation = translation * scaling;
 
         rasterizer.clear();
 
         // Render each entity
-        for (auto& [name, entity] : entities)
-            entity->render(transformation, this);
+        for (Entity& entity : entities)
+            entity.render(transformation, this);
 
+        // Fill polygons binned while rendering entities
+        if (tiledRendering)
+        {
+            FrameStats::Clock::time_point start = FrameStats::Clock::now();
+
+            tiledRasterizer.flush();
+
+            stats.add_time(FrameStats::Rasterization, start);
+        }
+
+        rasterizer.take_occlusion_stats(stats.trianglesOccluded, stats.pixelsOccluded);
+        tiledRasterizer.take_occlusion_stats(stats.trianglesOccluded, stats.pixelsOccluded);
+
+        stats.arenaBytes = frameArena.get_used();
+    }
+
+    void View::present()
+    {
         // Swap buffers
 
         color_buffer.blit_to_window();
     }
 
+    bool View::is_scene_loaded()
+    {
+        if (sceneLoaded) return true;
+
+        for (const Entity& entity : entities)
+        {
+            if (not entity.is_loaded()) return false;
+        }
+
+        // Keep time of the first check seeing every model
+        loadTime = std::chrono::duration< double, std::milli >(FrameStats::Clock::now() - loadStart).count();
+        sceneLoaded = true;
+
+        return true;
+    }
+
+    void View::wait_for_scene()
+    {
+        loaders.wait_idle();
+
+        is_scene_loaded();
+    }
+
+    EntityHandle View::add_entity(const std::string& name, const char* model_path, EntityHandle parent)
+    {
+        EntityHandle handle = EntityHandle(entities.size());
+
+        // Parents before children keeps the array in update order
+        assert(parent == no_entity || parent < handle);
+        assert(entityIndex.count(name) == 0);
+
+        entities.emplace_back(models.get(model_path), parent);
+        entityIndex.emplace(name, handle);
+
+        return handle;
+    }
+
+    EntityHandle View::find_entity(const std::string& name) const
+    {
+        auto entry = entityIndex.find(name);
+
+        return entry != entityIndex.end() ? entry->second : no_entity;
+    }
+
     void View::process_events(Event& sfEvent, float delta)
     {
         vec2 currentMousePosition = vec2(Mouse::getPosition().x, Mouse::getPosition().y);
@@ -154,16 +269,123 @@ namespace MGVisualizer
 
     void View::rasterizer_fill_polygon(const ivec4* const vertices, const int* const indices_begin, const int* const indices_end)
     {
-        if(vertices != nullptr)
+        if (vertices == nullptr) return;
+
+        if (tiledRendering)
+            tiledRasterizer.submit(vertices, indices_begin, indices_end, rasterizer.get_color());
+        else
             rasterizer.fill_convex_polygon_z_buffer(vertices, indices_begin, indices_end);
     }
 
+    void View::rasterizer_fill_polygon(const ivec4* const vertices, const Color* const colors, const int* const indices_begin, const int* const indices_end)
+    {
+        if (vertices == nullptr) return;
+
+        if (tiledRendering)
+            tiledRasterizer.submit(vertices, indices_begin, indices_end, rasterizer.get_color(), colors);
+        else
+            rasterizer.fill_convex_polygon_z_buffer(vertices, colors, indices_begin, indices_end);
+    }
+
+    void View::set_occlusion_culling(bool enabled)
+    {
+        rasterizer.set_hierarchical_z(enabled);
+    }
+
+    void View::set_fill_mode(Rasterizer< Color_Buffer >::Fill_Modes mode)
+    {
+        rasterizer.set_fill_mode(mode);
+    }
+
+    void View::set_depth_format(Rasterizer< Color_Buffer >::Depth_Formats format)
+    {
+        rasterizer.set_depth_format(format);
+    }
+
+    void View::set_shading_mode(Rasterizer< Color_Buffer >::Shading_Modes mode)
+    {
+        rasterizer.set_shading_mode(mode);
+    }
+
+    bool View::is_mesh_occluded(const mat4& clip_matrix, const mat4& viewport, const Mesh& mesh)
+    {
+        // Depth buffer is empty until tiles are flushed
+        if (tiledRendering) return false;
+
+        const vec3 corners[2] = { mesh.bounds_min, mesh.bounds_max };
+
+        vec2 display_min(std::numeric_limits< float >::max());
+        vec2 display_max(std::numeric_limits< float >::lowest());
+
+        int nearest_z = std::numeric_limits< int >::max();
+
+        for (int corner = 0; corner < 8; corner++)
+        {
+            vec4 vertex = clip_matrix * vec4(corners[corner & 1].x, corners[(corner >> 1) & 1].y, corners[corner >> 2].z, 1.f);
+
+            // Box crossing near plane can cover anything
+            if (vertex.z < -vertex.w || vertex.w <= 0.f) return false;
+
+            float divisor = 1.f / vertex.w;
+
+            vec2 display = vec2(viewport * vec4(vertex.x * divisor, vertex.y * divisor, vertex.z * divisor, 1.f));
+
+            display_min = min(display_min, display);
+            display_max = max(display_max, display);
+
+            nearest_z = std::min(nearest_z, rasterizer.get_depth_key(vertex.z, vertex.w));
+        }
+
+        // Display coordinates may be sub-pixel positions
+        float pixel = 1.f / float(1 << rasterizer.get_subpixel_bits());
+
+        // Projected box encloses every projected vertex, its nearest corner is not farther than any of them
+        Rasterizer< Color_Buffer >::Scissor area;
+        area.x0 = int(std::floor(display_min.x * pixel));
+        area.y0 = int(std::floor(display_min.y * pixel));
+        area.x1 = int(std::ceil(display_max.x * pixel)) + 1;
+        area.y1 = int(std::ceil(display_max.y * pixel)) + 1;
+
+        return rasterizer.is_occluded(area, nearest_z - 1);
+    }
+
+    void View::set_guard_band(float size)
+    {
+        guardBand = std::max(size, 1.f);
+
+        // Scanlines the guard band reaches above and below the color buffer
+        unsigned margin = unsigned(std::ceil((guardBand - 1.f) * 0.5f * height)) + 1;
+
+        rasterizer.set_guard_margin(margin);
+        tiledRasterizer.set_guard_margin(margin);
+    }
+
     bool View::is_backface(const vec4* const projected_vertices, const int* const indices)
     {
         const vec4& v0 = projected_vertices[indices[0]];
         const vec4& v1 = projected_vertices[indices[1]];
         const vec4& v2 = projected_vertices[indices[2]];
 
-        return ((v1[0] - v0[0]) * (v2[1] - v0[1]) - (v2[0] - v0[0]) * (v1[1] - v0[1]) < 0.f);
+        // Homogeneous determinant of x, y, w keeps the screen space winding for vertices
+        // in front of the camera and stays valid for vertices behind it
+        float determinant =
+            v0.x * (v1.y * v2.w - v2.y * v1.w) -
+            v1.x * (v0.y * v2.w - v2.y * v0.w) +
+            v2.x * (v0.y * v1.w - v1.y * v0.w);
+
+        return determinant < 0.f;
+    }
+
+    bool View::is_backface(const ivec4* const display_vertices, const int* const indices)
+    {
+        const ivec4& v0 = display_vertices[indices[0]];
+        const ivec4& v1 = display_vertices[indices[1]];
+        const ivec4& v2 = display_vertices[indices[2]];
+
+        // With every w positive the homogeneous determinant has the sign of the screen space area.
+        // Triangles degenerated by rounding cover no pixel either.
+        int64_t area = int64_t(v1.x - v0.x) * (v2.y - v0.y) - int64_t(v2.x - v0.x) * (v1.y - v0.y);
+
+        return area <= 0;
     }
 }
\ No newline at end of file
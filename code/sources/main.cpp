@@ -5,23 +5,148 @@
 
 #include <SFML/Window.hpp>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "Rasterizer.h"
 #include "View.h"
+#include "Benchmark.h"
+#include "SceneFile.h"
 
 using namespace sf;
 using namespace std::chrono;
 using namespace MGVisualizer;
 
-int main()
+int main(int argc, char* argv[])
 {
-	// Create the window
 	constexpr auto window_width = 800u;
 	constexpr auto window_height = 600u;
 
+	// Span kernels microbenchmark
+	if (argc > 1 && std::strcmp(argv[1], "--span-benchmark") == 0)
+	{
+		Benchmark::run_span_kernels();
+
+		return 0;
+	}
+
+	// Fill modes microbenchmark
+	if (argc > 1 && std::strcmp(argv[1], "--fill-benchmark") == 0)
+	{
+		Benchmark::run_fill_modes();
+
+		return 0;
+	}
+
+	// Depth formats precision report
+	if (argc > 1 && std::strcmp(argv[1], "--depth-benchmark") == 0)
+	{
+		Benchmark::run_depth_formats();
+
+		return 0;
+	}
+
+	// Synthetic scene for load testing: --generate-scene path entities [seed] [--binary]
+	if (argc > 3 && std::strcmp(argv[1], "--generate-scene") == 0)
+	{
+		unsigned seed = 1;
+		bool binary = false;
+
+		for (int i = 4; i < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--binary") == 0)
+				binary = true;
+			else
+				seed = unsigned(std::atoi(argv[i]));
+		}
+
+		SceneFile scene = SceneFile::generate_stress(unsigned(std::atoi(argv[3])), seed);
+
+		if (not scene.save(argv[2], binary))
+		{
+			std::printf("could not write scene %s\n", argv[2]);
+			return 1;
+		}
+
+		return 0;
+	}
+
+	// Scene rendered by the benchmark and the window
+	const char* scenePath = View::default_scene;
+
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--scene") == 0)
+			scenePath = argv[i + 1];
+	}
+
+	// Headless run: --benchmark [frames] [width] [height] [--scene path] [--serial] [--no-occlusion] [--no-lod] [--half-space] [--float-depth] [--gouraud] [--two-phase] [--check-allocations]
+	if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+	{
+		unsigned arguments[] = { 300u, window_width, window_height };
+		unsigned argumentsCount = 0;
+		bool serial = false;
+		bool occlusion = true;
+		bool lod = true;
+		bool halfSpace = false;
+		bool floatDepth = false;
+		bool gouraud = false;
+		bool twoPhase = false;
+		bool checkAllocations = false;
+
+		for (int i = 2; i < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--scene") == 0)
+				i++;
+			else if (std::strcmp(argv[i], "--serial") == 0)
+				serial = true;
+			else if (std::strcmp(argv[i], "--no-occlusion") == 0)
+				occlusion = false;
+			else if (std::strcmp(argv[i], "--no-lod") == 0)
+				lod = false;
+			else if (std::strcmp(argv[i], "--half-space") == 0)
+				halfSpace = true;
+			else if (std::strcmp(argv[i], "--float-depth") == 0)
+				floatDepth = true;
+			else if (std::strcmp(argv[i], "--gouraud") == 0)
+				gouraud = true;
+			else if (std::strcmp(argv[i], "--two-phase") == 0)
+				twoPhase = true;
+			else if (std::strcmp(argv[i], "--check-allocations") == 0)
+				checkAllocations = true;
+			else if (argumentsCount < 3)
+				arguments[argumentsCount++] = unsigned(std::atoi(argv[i]));
+		}
+
+		Benchmark benchmark(arguments[1], arguments[2], arguments[0]);
+		benchmark.set_scene(scenePath);
+		benchmark.set_tiled_rendering(not serial);
+		benchmark.set_occlusion_culling(occlusion);
+		benchmark.set_levels_of_detail(lod);
+		benchmark.set_fill_mode(halfSpace ? Rasterizer< View::Color_Buffer >::HALF_SPACE_FILL : Rasterizer< View::Color_Buffer >::SCANLINE_FILL);
+		benchmark.set_depth_format(floatDepth ? Rasterizer< View::Color_Buffer >::FLOAT_REVERSED_DEPTH : Rasterizer< View::Color_Buffer >::FIXED_24_DEPTH);
+		benchmark.set_shading_mode(gouraud ? Rasterizer< View::Color_Buffer >::GOURAUD_SHADING : Rasterizer< View::Color_Buffer >::FLAT_SHADING);
+		benchmark.set_fused_vertex_stage(not twoPhase);
+		benchmark.set_allocation_check(checkAllocations);
+
+		// Failed scene load or allocation check is reported through the exit code
+		return benchmark.run() ? 0 : 1;
+	}
+
+	// Create the window
+
 	Window window(VideoMode(window_width, window_height), "MGSceneLoader", Style::Titlebar | Style::Close);
     View   view(window_width, window_height);
 
+	std::string error;
+
+	if (not view.load_scene(scenePath, &error))
+	{
+		std::printf("could not load scene %s: %s\n", scenePath, error.c_str());
+		return 1;
+	}
+
 	window.setVerticalSyncEnabled(true);
 
     // Delta time variables
@@ -50,6 +175,8 @@ int main()
 
         view.render();
 
+        view.present();
+
         window.display();
 
         delta_time = duration<float>(chrono.now() - start).count();